@@ -0,0 +1,132 @@
+#include "BlueNoise.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+
+namespace GModDXR
+{
+	// Toroidal gaussian energy of a binary pattern, updated incrementally as pixels are toggled
+	class EnergyField
+	{
+	public:
+		EnergyField(uint32_t size, float sigma) : size(size), energy(size * size, 0.f), kernel(size * size)
+		{
+			// Precompute the kernel for every wrapped offset so updates are a single pass with no exp calls
+			for (uint32_t y = 0; y < size; y++) {
+				for (uint32_t x = 0; x < size; x++) {
+					const float dx = static_cast<float>(std::min(x, size - x));
+					const float dy = static_cast<float>(std::min(y, size - y));
+					kernel[y * size + x] = std::exp(-(dx * dx + dy * dy) / (2.f * sigma * sigma));
+				}
+			}
+		}
+
+		void toggle(uint32_t index, bool on)
+		{
+			const uint32_t px = index % size;
+			const uint32_t py = index / size;
+			const float sign = on ? 1.f : -1.f;
+			for (uint32_t y = 0; y < size; y++) {
+				const uint32_t ky = (y + size - py) % size;
+				for (uint32_t x = 0; x < size; x++) {
+					const uint32_t kx = (x + size - px) % size;
+					energy[y * size + x] += sign * kernel[ky * size + kx];
+				}
+			}
+		}
+
+		// Tightest cluster is the set pixel with the most energy, largest void the unset pixel with the least
+		uint32_t tightestCluster(const std::vector<uint8_t>& pattern) const
+		{
+			uint32_t best = 0;
+			float bestEnergy = -std::numeric_limits<float>::max();
+			for (uint32_t i = 0; i < pattern.size(); i++) {
+				if (pattern[i] && energy[i] > bestEnergy) {
+					best = i;
+					bestEnergy = energy[i];
+				}
+			}
+			return best;
+		}
+
+		uint32_t largestVoid(const std::vector<uint8_t>& pattern) const
+		{
+			uint32_t best = 0;
+			float bestEnergy = std::numeric_limits<float>::max();
+			for (uint32_t i = 0; i < pattern.size(); i++) {
+				if (!pattern[i] && energy[i] < bestEnergy) {
+					best = i;
+					bestEnergy = energy[i];
+				}
+			}
+			return best;
+		}
+
+	private:
+		uint32_t size;
+		std::vector<float> energy;
+		std::vector<float> kernel;
+	};
+
+	std::vector<float> generateBlueNoise(uint32_t size, uint32_t seed, float sigma)
+	{
+		const uint32_t count = size * size;
+		const uint32_t initialOnes = std::max(count / 10U, 1U);
+
+		// Random initial pattern with ~10% of pixels set
+		std::vector<uint8_t> initial(count, 0);
+		std::vector<uint32_t> shuffled(count);
+		for (uint32_t i = 0; i < count; i++) shuffled[i] = i;
+		std::shuffle(shuffled.begin(), shuffled.end(), std::mt19937(seed));
+
+		EnergyField field(size, sigma);
+		for (uint32_t i = 0; i < initialOnes; i++) {
+			initial[shuffled[i]] = 1;
+			field.toggle(shuffled[i], true);
+		}
+
+		// Relax it into a blue noise pattern by moving the tightest cluster into the largest void until that's a no-op
+		// (capped in case it ever cycles rather than settling)
+		for (uint32_t iteration = 0; iteration < count; iteration++) {
+			const uint32_t cluster = field.tightestCluster(initial);
+			initial[cluster] = 0;
+			field.toggle(cluster, false);
+
+			const uint32_t gap = field.largestVoid(initial);
+			initial[gap] = 1;
+			field.toggle(gap, true);
+
+			if (gap == cluster) break;
+		}
+
+		std::vector<uint32_t> rank(count, 0);
+
+		// Phase 1: rank the initial ones by repeatedly removing the tightest cluster
+		{
+			std::vector<uint8_t> pattern = initial;
+			EnergyField phaseField = field;
+			for (uint32_t r = initialOnes; r-- > 0;) {
+				const uint32_t cluster = phaseField.tightestCluster(pattern);
+				pattern[cluster] = 0;
+				phaseField.toggle(cluster, false);
+				rank[cluster] = r;
+			}
+		}
+
+		// Phase 2 and 3: rank the rest by repeatedly filling the largest void
+		{
+			std::vector<uint8_t> pattern = initial;
+			for (uint32_t r = initialOnes; r < count; r++) {
+				const uint32_t gap = field.largestVoid(pattern);
+				pattern[gap] = 1;
+				field.toggle(gap, true);
+				rank[gap] = r;
+			}
+		}
+
+		std::vector<float> mask(count);
+		for (uint32_t i = 0; i < count; i++) mask[i] = (static_cast<float>(rank[i]) + 0.5f) / static_cast<float>(count);
+		return mask;
+	}
+}
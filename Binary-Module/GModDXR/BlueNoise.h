@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace GModDXR
+{
+	/*
+		Generates a tileable size x size blue noise mask using the void and cluster method (Ulichney 1993)
+
+		Returns one value per pixel in [0, 1), with every value appearing once (the pixel's rank / size^2 plus half a step)
+		Generation is O(size^4), which is well under a second for the 64x64 mask the path tracer uses
+	*/
+	std::vector<float> generateBlueNoise(uint32_t size, uint32_t seed = 1U, float sigma = 1.9f);
+}
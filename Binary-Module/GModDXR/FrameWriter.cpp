@@ -0,0 +1,86 @@
+#include "FrameWriter.h"
+#include "glm/gtc/packing.hpp"
+
+namespace GModDXR
+{
+	using namespace Falcor;
+
+	FrameWriter::UniquePtr FrameWriter::create(uint32_t workerCount)
+	{
+		return UniquePtr(new FrameWriter(workerCount));
+	}
+
+	FrameWriter::FrameWriter(uint32_t workerCount)
+		: readbacks(kMaxReadbacks, kReadbackLatency)
+		, workers(workerCount)
+	{
+	}
+
+	FrameWriter::~FrameWriter()
+	{
+		// Anything still being read back is waited on here rather than dropped, then the workers finish the queue
+		readbacks.drain([this](Readback&& readback) { collect(std::move(readback)); });
+	}
+
+	void FrameWriter::capture(RenderContext* pContext, const Texture::SharedPtr& pTexture, const std::string& filename, Bitmap::FileFormat fileFormat)
+	{
+		Readback readback;
+		readback.pTask = pContext->asyncReadTextureSubresource(pTexture.get(), 0);
+		readback.image.filename = filename;
+		readback.image.width = pTexture->getWidth();
+		readback.image.height = pTexture->getHeight();
+		readback.image.format = pTexture->getFormat();
+		readback.image.fileFormat = fileFormat;
+		readbacks.push(std::move(readback), [this](Readback&& oldest) { collect(std::move(oldest)); });
+	}
+
+	void FrameWriter::update()
+	{
+		readbacks.advance([this](Readback&& readback) { collect(std::move(readback)); });
+	}
+
+	void FrameWriter::collect(Readback&& readback)
+	{
+		readback.image.data = readback.pTask->getData();
+		enqueue(std::move(readback.image));
+	}
+
+	void FrameWriter::enqueue(Image image)
+	{
+		workers.enqueue([this, image = std::move(image)]() mutable {
+			encode(image);
+			written++;
+		});
+	}
+
+	size_t FrameWriter::getPendingCount()
+	{
+		return readbacks.size() + workers.getPendingCount();
+	}
+
+	void FrameWriter::encode(Image& image)
+	{
+		// FreeImage's EXR path wants 32 bit floats, so half float captures are widened first
+		if (image.format == ResourceFormat::RGBA16Float) {
+			const size_t count = static_cast<size_t>(image.width) * image.height * 4U;
+			const uint16_t* pHalves = reinterpret_cast<const uint16_t*>(image.data.data());
+
+			std::vector<uint8_t> widened(count * sizeof(float));
+			float* pFloats = reinterpret_cast<float*>(widened.data());
+			for (size_t i = 0; i < count; i++) pFloats[i] = glm::unpackHalf1x16(pHalves[i]);
+
+			image.data.swap(widened);
+			image.format = ResourceFormat::RGBA32Float;
+		}
+
+		// The swap chain is BGRA, which saveImage would write out with red and blue swapped
+		if (image.format == ResourceFormat::BGRA8Unorm || image.format == ResourceFormat::BGRA8UnormSrgb) {
+			const size_t count = static_cast<size_t>(image.width) * image.height;
+			for (size_t i = 0; i < count; i++) std::swap(image.data[i * 4U], image.data[i * 4U + 2U]);
+			image.format = image.format == ResourceFormat::BGRA8Unorm ? ResourceFormat::RGBA8Unorm : ResourceFormat::RGBA8UnormSrgb;
+		}
+
+		Bitmap::saveImage(image.filename, image.width, image.height, image.fileFormat, Bitmap::ExportFlags::None, image.format, true, image.data.data());
+		logInfo("Saved " + image.filename);
+	}
+}
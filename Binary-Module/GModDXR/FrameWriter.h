@@ -0,0 +1,67 @@
+#pragma once
+
+#include "Falcor.h"
+#include "ReadbackRing.h"
+#include "WorkerPool.h"
+
+namespace GModDXR
+{
+	/*
+		Saves frames to disk without stalling the render thread
+
+		Captures are read back asynchronously and only collected once their copy has had a few frames to finish,
+		then a pool of worker threads encodes them (EXR for HDR, PNG for LDR)
+		Captures are never dropped, if too many are in flight the oldest is collected early (stalling on it if it hasn't finished)
+	*/
+	class FrameWriter
+	{
+	public:
+		using UniquePtr = std::unique_ptr<FrameWriter>;
+
+		// An image waiting to be encoded, rows are tightly packed in the given format
+		struct Image
+		{
+			std::string filename;
+			uint32_t width = 0;
+			uint32_t height = 0;
+			Falcor::ResourceFormat format = Falcor::ResourceFormat::Unknown;
+			Falcor::Bitmap::FileFormat fileFormat = Falcor::Bitmap::FileFormat::PngFile;
+			std::vector<uint8_t> data;
+		};
+
+		static UniquePtr create(uint32_t workerCount = 2);
+		~FrameWriter(); // Finishes encoding everything queued before returning
+
+		// Queues a readback of the texture
+		void capture(Falcor::RenderContext* pContext, const Falcor::Texture::SharedPtr& pTexture, const std::string& filename, Falcor::Bitmap::FileFormat fileFormat);
+
+		// Collects finished readbacks and hands them to the workers, call once per frame
+		void update();
+
+		// Queues an image for encoding directly (no GPU involved)
+		void enqueue(Image image);
+
+		size_t getPendingCount();
+		size_t getWrittenCount() const { return written; }
+		size_t getStalledCount() const { return readbacks.getEarlyCollections(); }
+
+	private:
+		FrameWriter(uint32_t workerCount);
+
+		static const uint32_t kMaxReadbacks = 8;
+		static const uint64_t kReadbackLatency = 3; // Frames before a readback is collected, so its fence has already passed
+
+		struct Readback
+		{
+			Falcor::CopyContext::ReadTextureTask::SharedPtr pTask;
+			Image image;
+		};
+
+		ReadbackRing<Readback> readbacks;
+		std::atomic<size_t> written = 0;
+		WorkerPool workers; // Declared last so it finishes its jobs before anything they use is destroyed
+
+		void collect(Readback&& readback);
+		static void encode(Image& image);
+	};
+}
@@ -1,4 +1,7 @@
 #include "Renderer.h"
+#include "SceneCache.h"
+#include "MemoryTracker.h"
+#include "SceneSnapshot.h"
 #include "GarrysMod/Lua/Interface.h"
 
 Falcor::float3 gmodToGLMVec(Vector vec) { return Falcor::float3(vec.x, vec.z, -vec.y); }
@@ -20,27 +23,70 @@ std::vector<Falcor::float3> computeBrushNormals(const Falcor::float3* positions,
 static std::thread mainThread;
 static std::mutex mut;
 static GModDXR::WorldData worldData;
+static GModDXR::HashCache<GModDXR::MeshData::SharedPtr> meshCache;
 static bool TRACING = false;
 void falcorThreadWrapper(
 	const Vector camPos, const Vector camTarget,
-	std::vector<Falcor::TriangleMesh::SharedPtr> meshes, std::vector<Falcor::Material::SharedPtr> materials, std::vector<Falcor::SceneBuilder::Node> nodes, std::vector<GModDXR::TextureDesc> textures
+	std::vector<GModDXR::MeshData::SharedPtr> meshes, std::vector<Falcor::Material::SharedPtr> materials, std::vector<Falcor::SceneBuilder::Node> nodes, std::vector<GModDXR::TextureDesc> textures
 ) {
-	// Create renderer
-	GModDXR::Renderer::UniquePtr pRenderer = std::make_unique<GModDXR::Renderer>();
+	GModDXR::runRenderer(&worldData, gmodToGLMVec(camPos), gmodToGLMVec(camTarget), &meshes, &materials, &nodes, &textures);
 
-	// Get raw casted pointer to GModDXR::Renderer to access custom methods in the derived class
-	GModDXR::Renderer* pRendererRaw = reinterpret_cast<GModDXR::Renderer*>(pRenderer.get());
-	pRendererRaw->setWorldData(&worldData);
-	pRendererRaw->setCameraDefaults(gmodToGLMVec(camPos), gmodToGLMVec(camTarget));
-	pRendererRaw->setEntities(&meshes, &materials, &nodes, &textures);
-	pRendererRaw = nullptr;
+	// Let the main thread know we're done
+	mut.lock();
+	TRACING = false;
+	mut.unlock();
+}
 
-	// Create window config
-	Falcor::SampleConfig config;
-	config.windowDesc.title = "Garry's Mod DXR";
-	config.windowDesc.resizableWindow = true;
+/*
+	Runs the renderer as a separate process (GModDXRHost.exe next to the game executable) and streams the scene to it
+	A crash or device removal in the renderer then only takes down that process
+*/
+static const uint64_t kChannelCapacity = 64ULL * 1024 * 1024;
+static const uint32_t kChannelTimeoutMs = 30000;
+static uint32_t hostLaunches = 0;
+void hostThreadWrapper(GModDXR::SceneSnapshot snapshot)
+{
+	const std::string channelName = "GModDXR_" + std::to_string(GetCurrentProcessId()) + "_" + std::to_string(hostLaunches++);
+	GModDXR::SceneChannel::UniquePtr pChannel = GModDXR::SceneChannel::create(channelName, kChannelCapacity);
+
+	STARTUPINFOA startupInfo = { sizeof(STARTUPINFOA) };
+	PROCESS_INFORMATION processInfo = {};
+	std::string commandLine = "\"" + Falcor::getExecutableDirectory() + "/GModDXRHost.exe\" " + channelName;
+	const bool launched = pChannel && CreateProcessA(nullptr, commandLine.data(), nullptr, nullptr, FALSE, 0, nullptr, Falcor::getExecutableDirectory().c_str(), &startupInfo, &processInfo);
+
+	if (!launched) {
+		Falcor::logError("Failed to start the renderer process (" + commandLine + ")");
+	} else {
+		// If the renderer exits before it's read everything (a crash, or a bad argument), closing the channel fails the send straight away
+		// rather than after the timeout
+		std::thread exitWatcher([&pChannel, hProcess = processInfo.hProcess]() {
+			WaitForSingleObject(hProcess, INFINITE);
+			pChannel->close();
+		});
+
+		// Every launch is a new process, so the whole scene is sent (submeshes shared between entities only once)
+		std::unordered_set<uint64_t> sentMeshes;
+		const uint64_t start = GModDXR::SceneChannel::now();
+		const bool sent =
+			pChannel->waitForConsumer(kChannelTimeoutMs) &&
+			GModDXR::sendHello(*pChannel, kChannelTimeoutMs) &&
+			GModDXR::sendSnapshot(*pChannel, snapshot, sentMeshes, kChannelTimeoutMs);
+
+		if (sent) {
+			Falcor::logInfo("Sent scene to the renderer process in " + std::to_string((GModDXR::SceneChannel::now() - start) / 1000000) + "ms");
+		} else if (WaitForSingleObject(processInfo.hProcess, 0) == WAIT_OBJECT_0) {
+			DWORD exitCode = 0;
+			GetExitCodeProcess(processInfo.hProcess, &exitCode);
+			Falcor::logError("Renderer process exited before the scene was sent (exit code " + std::to_string(exitCode) + ")");
+		} else {
+			Falcor::logError("Renderer process stopped reading the scene");
+			TerminateProcess(processInfo.hProcess, 1);
+		}
 
-	Falcor::Sample::run(config, pRenderer);
+		exitWatcher.join(); // Returns once the process has exited
+		CloseHandle(processInfo.hThread);
+		CloseHandle(processInfo.hProcess);
+	}
 
 	// Let the main thread know we're done
 	mut.lock();
@@ -147,6 +193,42 @@ bool checkMaterialFlags(GarrysMod::Lua::ILuaBase* LUA, const MaterialFlags flags
 	return (flagVal & static_cast<unsigned int>(flags)) == static_cast<unsigned int>(flags);
 }
 
+// Limits on what gets captured and how it's stored, read from the optional options table passed to LaunchFalcor
+struct CapturePolicy
+{
+	double triangleBudget = 4000000.0; // Total entity triangles, 0 for no limit
+	double minScreenSize = 0.002;      // Entities with a smaller bounding radius to distance ratio are skipped
+	double lodScreenSize = 0.02;       // Entities smaller than this use LOD 1, and 2 below a tenth of it
+	bool compactCpuVertices = false;   // Keep captured geometry quantised in CPU memory (see GModDXR::PackedVertex), GPU buffers are unchanged
+	bool outOfProcess = false;         // Render in a separate process fed over shared memory (see hostThreadWrapper)
+};
+
+struct CaptureCandidate
+{
+	size_t index;
+	float screenSize;
+};
+
+// Gets the number value at a key in the table at the given stack position, or the fallback if it isn't a number
+double getOptionNumber(GarrysMod::Lua::ILuaBase* LUA, int tablePos, const char* key, double fallback)
+{
+	LUA->GetField(tablePos, key);
+	double val = LUA->IsType(-1, GarrysMod::Lua::Type::Number) ? LUA->GetNumber() : fallback;
+	LUA->Pop();
+
+	return val;
+}
+
+// Gets the bool value at a key in the table at the given stack position, or the fallback if it isn't a bool
+bool getOptionBool(GarrysMod::Lua::ILuaBase* LUA, int tablePos, const char* key, bool fallback)
+{
+	LUA->GetField(tablePos, key);
+	bool val = LUA->IsType(-1, GarrysMod::Lua::Type::Bool) ? LUA->GetBool() : fallback;
+	LUA->Pop();
+
+	return val;
+}
+
 /*
 	Entrypoint for the application when loaded from GLua
 	
@@ -157,19 +239,42 @@ bool checkMaterialFlags(GarrysMod::Lua::ILuaBase* LUA, const MaterialFlags flags
 	- Vector        Camera up vector
 	- Vector        Sun direction
 	- table<Entity> Table of entities
+	- table         (Optional) Capture options: triangleBudget, minScreenSize, lodScreenSize, compactCpuVertices, outOfProcess
 */
 LUA_FUNCTION(LaunchFalcor)
 {
 	using namespace GarrysMod::Lua;
 	if (TRACING) return 0;
 
-	auto meshes = std::vector<Falcor::TriangleMesh::SharedPtr>();
+	auto meshes = std::vector<GModDXR::MeshData::SharedPtr>();
 	auto materials = std::vector<Falcor::Material::SharedPtr>();
 	auto nodes = std::vector<Falcor::SceneBuilder::Node>();
 	auto textures = std::vector<GModDXR::TextureDesc>();
+	auto meshHashes = std::vector<uint64_t>();
+	auto colours = std::vector<Falcor::float4>();
+	meshCache.beginLaunch();
+
+	// Read capture options, then drop anything past the entity table so it's back on top of the stack
+	CapturePolicy policy;
+	if (LUA->Top() >= 7 && LUA->IsType(7, Type::Table)) {
+		policy.triangleBudget = getOptionNumber(LUA, 7, "triangleBudget", policy.triangleBudget);
+		policy.minScreenSize = getOptionNumber(LUA, 7, "minScreenSize", policy.minScreenSize);
+		policy.lodScreenSize = getOptionNumber(LUA, 7, "lodScreenSize", policy.lodScreenSize);
+		policy.compactCpuVertices = getOptionBool(LUA, 7, "compactCpuVertices", policy.compactCpuVertices);
+		policy.outOfProcess = getOptionBool(LUA, 7, "outOfProcess", policy.outOfProcess);
+	}
+	if (LUA->Top() > 6) LUA->Pop(LUA->Top() - 6);
+
+	const Vector camPos = LUA->GetVector(3);
+	const Vector camTarget = LUA->GetVector(4);
+	const Falcor::float3 camPosF = gmodToGLMVec(camPos);
+	const Falcor::float3 camForward = glm::normalize(gmodToGLMVec(camTarget) - camPosF);
 
-	// Iterate over entities
+	// Rank entities by how large they appear from the launch camera
+	// Anything behind the camera still shows up in reflections and shadows, so it's only deprioritised
 	size_t numEntities = LUA->ObjLen(6);
+	size_t skippedSmall = 0, skippedBudget = 0, reducedLod = 0;
+	auto candidates = std::vector<CaptureCandidate>();
 	for (size_t entIndex = 1; entIndex <= numEntities; entIndex++) {
 		// Get entity
 		LUA->PushNumber(entIndex);
@@ -183,6 +288,38 @@ LUA_FUNCTION(LaunchFalcor)
 		if (!LUA->GetBool()) LUA->ThrowError("Attempted to launch Falcor with an invalid entity");
 		LUA->Pop(); // Pop the bool
 
+		LUA->GetField(-1, "WorldSpaceCenter");
+		LUA->Push(-2);
+		LUA->Call(1, 1);
+		const Falcor::float3 centre = gmodToGLMVec(LUA->GetVector());
+		LUA->Pop();
+
+		LUA->GetField(-1, "BoundingRadius");
+		LUA->Push(-2);
+		LUA->Call(1, 1);
+		const float radius = static_cast<float>(LUA->GetNumber());
+		LUA->Pop(2); // Pop the radius and entity
+
+		const Falcor::float3 toEntity = centre - camPosF;
+		const float distance = glm::length(toEntity);
+		float screenSize = radius / std::max(distance, std::max(radius, 1.f));
+		if (distance > radius && glm::dot(toEntity, camForward) < 0.f) screenSize *= 0.5f;
+
+		if (screenSize < policy.minScreenSize) {
+			skippedSmall++;
+			continue;
+		}
+		candidates.push_back(CaptureCandidate{ entIndex, screenSize });
+	}
+	std::sort(candidates.begin(), candidates.end(), [](const CaptureCandidate& a, const CaptureCandidate& b) { return a.screenSize > b.screenSize; });
+
+	// Iterate over entities, largest on screen first so the budget is spent where it's most visible
+	size_t capturedTris = 0;
+	for (const CaptureCandidate& candidate : candidates) {
+		// Get entity
+		LUA->PushNumber(candidate.index);
+		LUA->GetTable(6);
+
 		// Cache bone transforms
 		// Make sure the bone transforms are updated and the bones themselves are valid
 		LUA->GetField(-1, "SetupBones");
@@ -234,7 +371,12 @@ LUA_FUNCTION(LaunchFalcor)
 		LUA->Push(-5);
 		LUA->Call(1, 1);
 		const std::string modelName = LUA->CheckString();
-		LUA->Call(1, 2);
+
+		// Small entities get a coarser LOD as a proxy (the engine clamps this to the LODs the model has)
+		int lod = 0;
+		if (candidate.screenSize < policy.lodScreenSize) lod = candidate.screenSize < policy.lodScreenSize * 0.1 ? 2 : 1;
+		LUA->PushNumber(lod);
+		LUA->Call(2, 2);
 
 		// Make sure both return values are present and valid
 		if (!LUA->IsType(-2, Type::Table)) LUA->ThrowError("Entity model invalid");
@@ -270,16 +412,26 @@ LUA_FUNCTION(LaunchFalcor)
 		LUA->Pop();
 
 		size_t numSubmeshes = LUA->ObjLen();
+
+		// Skip the entity if it doesn't fit in what's left of the triangle budget
+		size_t entityTris = 0;
 		for (size_t meshIndex = 1; meshIndex <= numSubmeshes; meshIndex++) {
-			// Create empty mesh and material
-			Falcor::TriangleMesh::SharedPtr pMesh = Falcor::TriangleMesh::create();
-			pMesh->setName(modelName);
+			LUA->PushNumber(meshIndex);
+			LUA->GetTable(-2);
+			LUA->GetField(-1, "triangles");
+			if (LUA->IsType(-1, Type::Table)) entityTris += LUA->ObjLen() / 3U;
+			LUA->Pop(2);
+		}
 
-			Falcor::Material::SharedPtr pMaterial = Falcor::Material::create("Entity");
-			pMaterial->setShadingModel(ShadingModelMetalRough);
-			pMaterial->setRoughness(1.f); // Placeholder
-			pMaterial->setMetallic(0.f);  // Placeholder
+		if (policy.triangleBudget > 0.0 && static_cast<double>(capturedTris + entityTris) > policy.triangleBudget) {
+			skippedBudget++;
+			LUA->Pop(4); // Pop meshes, util, and _G tables, and the entity
+			continue;
+		}
+		capturedTris += entityTris;
+		if (lod > 0) reducedLod++;
 
+		for (size_t meshIndex = 1; meshIndex <= numSubmeshes; meshIndex++) {
 			// Get mesh
 			LUA->PushNumber(meshIndex);
 			LUA->GetTable(-2);
@@ -290,6 +442,10 @@ LUA_FUNCTION(LaunchFalcor)
 			size_t numVerts = LUA->ObjLen();
 			if (numVerts % 3U != 0U) LUA->ThrowError("Number of triangles is not a multiple of 3");
 
+			auto positions = std::vector<Falcor::float3>(numVerts);
+			auto normals = std::vector<Falcor::float3>(numVerts);
+			auto uvs = std::vector<Falcor::float2>(numVerts);
+
 			for (size_t vertIndex = 0; vertIndex < numVerts; vertIndex++) {
 				// Get vertex
 				LUA->PushNumber(vertIndex + 1U);
@@ -336,14 +492,27 @@ LUA_FUNCTION(LaunchFalcor)
 				// Pop MeshVertex
 				LUA->Pop();
 
-				// Add vertex to mesh
-				pMesh->addVertex(pos, normal, uv);
-				if (vertIndex % 3 == 2) pMesh->addTriangle(vertIndex, vertIndex - 1U, vertIndex - 2U);
+				positions[vertIndex] = pos;
+				normals[vertIndex] = normal;
+				uvs[vertIndex] = uv;
 			}
 
 			// Pop triangle and mesh tables
 			LUA->Pop(2);
 
+			// Reuse last launch's mesh if the skinned vertices haven't changed (indices are implied by vertex order)
+			uint64_t meshHash = GModDXR::hashString(modelName);
+			meshHash = GModDXR::hashValue(policy.compactCpuVertices, meshHash);
+			meshHash = GModDXR::hashBytes(positions.data(), positions.size() * sizeof(Falcor::float3), meshHash);
+			meshHash = GModDXR::hashBytes(normals.data(), normals.size() * sizeof(Falcor::float3), meshHash);
+			meshHash = GModDXR::hashBytes(uvs.data(), uvs.size() * sizeof(Falcor::float2), meshHash);
+
+			GModDXR::MeshData::SharedPtr pMesh;
+			if (!meshCache.find(meshHash, pMesh)) {
+				pMesh = GModDXR::MeshData::create(modelName, std::move(positions), std::move(normals), std::move(uvs), policy.compactCpuVertices, true);
+				meshCache.insert(meshHash, pMesh);
+			}
+
 			// Get textures
 			std::string materialPath = "";
 			LUA->GetField(-4, "GetMaterial");
@@ -398,18 +567,10 @@ LUA_FUNCTION(LaunchFalcor)
 			LUA->Pop();
 			colour /= 255;
 
-			pMaterial->setBaseColor(colour);
-
-			pMaterial->setSpecularTransmission(1.f - colour[3]);
-			if (colour[3] < 1.f) pMaterial->setDoubleSided(true); // If the object is transparent, set it to double sided (note that this will only handle baseColour alpha, not transparent textures)
-			
-			pMaterial->setEmissiveColor(colour);
-			pMaterial->setEmissiveFactor(baseTexture == "lights/white" ? 1 : 0);
-
-			pMaterial->setName(baseTexture);
-
 			meshes.emplace_back(pMesh);
-			materials.emplace_back(pMaterial);
+			meshHashes.push_back(meshHash);
+			colours.push_back(colour);
+			materials.emplace_back(GModDXR::createEntityMaterial(colour, baseTexture));
 			nodes.push_back(Falcor::SceneBuilder::Node{ modelName, glm::identity<glm::mat4>(), glm::identity<glm::mat4>() });
 		}
 
@@ -417,10 +578,16 @@ LUA_FUNCTION(LaunchFalcor)
 	}
 	LUA->Pop(); // Pop entity table
 
-	// Read camera details and world vert count
+	const size_t capturedEntities = candidates.size() - skippedBudget;
+	const std::string captureMsg =
+		"GModDXR: Captured " + std::to_string(capturedEntities) + "/" + std::to_string(numEntities) + " entities (" +
+		std::to_string(capturedTris) + " triangles, ~" + std::to_string(capturedTris * 3U * (policy.compactCpuVertices ? sizeof(GModDXR::PackedVertex) : sizeof(Falcor::TriangleMesh::Vertex)) / (1024U * 1024U)) + "MB of vertices in CPU memory, " +
+		std::to_string(reducedLod) + " at a lower LOD), skipped " + std::to_string(skippedSmall) + " too small on screen and " +
+		std::to_string(skippedBudget) + " over the triangle budget";
+	printLua(LUA, captureMsg.c_str());
+
+	// Read world vert count and sun direction
 	const size_t worldVertCount = LUA->GetNumber(2);
-	const Vector camPos = LUA->GetVector(3);
-	const Vector camTarget = LUA->GetVector(4);
 	const Vector sunDir = LUA->GetVector(5);
 	LUA->Pop(4);
 
@@ -438,14 +605,37 @@ LUA_FUNCTION(LaunchFalcor)
 	LUA->Pop();
 
 	// Create world data
-	worldData.length = worldVertCount;
-	worldData.pPositions = worldPositions;
-	worldData.pNormals = computeBrushNormals(worldPositions.data(), worldVertCount);
+	worldData.hash = GModDXR::hashValue(policy.compactCpuVertices, GModDXR::hashBytes(worldPositions.data(), worldPositions.size() * sizeof(Falcor::float3)));
+	auto worldNormals = computeBrushNormals(worldPositions.data(), worldVertCount);
+	worldData.pGeometry = GModDXR::MeshData::create("World", std::move(worldPositions), std::move(worldNormals), {}, policy.compactCpuVertices, false);
 	worldData.sunDirection = gmodToGLMVec(sunDir);
 
+	const std::string reuseMsg =
+		"GModDXR: Reused " + std::to_string(meshCache.getHits()) + "/" + std::to_string(meshCache.getHits() + meshCache.getMisses()) +
+		" meshes from the last launch (" + std::to_string(static_cast<int>(meshCache.getReusePercent())) + "%)";
+	printLua(LUA, reuseMsg.c_str());
+
+	// Everything captured stays alive in the caches, so that's what's reported (not just this launch's meshes)
+	uint64_t captureBytes = worldData.pGeometry->getByteSize();
+	meshCache.forEach([&captureBytes](const GModDXR::MeshData::SharedPtr& pMesh) { captureBytes += pMesh->getByteSize(); });
+	GModDXR::MemoryTracker::get().setUsage(GModDXR::MemoryTracker::Category::Capture, captureBytes, 0);
+
 	// Run the sample
 	TRACING = true;
-	mainThread = std::thread(falcorThreadWrapper, camPos, camTarget, meshes, materials, nodes, textures);
+	if (policy.outOfProcess) {
+		GModDXR::SceneSnapshot snapshot;
+		snapshot.cameraPosition = camPosF;
+		snapshot.cameraTarget = gmodToGLMVec(camTarget);
+		snapshot.world = worldData;
+		snapshot.meshHashes = std::move(meshHashes);
+		snapshot.meshes = std::move(meshes);
+		snapshot.colours = std::move(colours);
+		snapshot.textures = std::move(textures);
+		for (const auto& node : nodes) snapshot.nodeNames.push_back(node.name);
+		mainThread = std::thread(hostThreadWrapper, std::move(snapshot));
+	} else {
+		mainThread = std::thread(falcorThreadWrapper, camPos, camTarget, std::move(meshes), std::move(materials), std::move(nodes), std::move(textures));
+	}
 	mainThread.detach();
 	return 0;
 }
@@ -0,0 +1,121 @@
+#include "MemoryTracker.h"
+#include <fstream>
+
+namespace GModDXR
+{
+	using namespace Falcor;
+
+	static std::string toMB(uint64_t bytes)
+	{
+		return std::to_string(bytes / (1024 * 1024)) + "MB";
+	}
+
+	MemoryTracker& MemoryTracker::get()
+	{
+		static MemoryTracker tracker;
+		return tracker;
+	}
+
+	const char* MemoryTracker::getCategoryName(Category category)
+	{
+		switch (category) {
+		case Category::Capture: return "Capture";
+		case Category::Geometry: return "Geometry";
+		case Category::Textures: return "Textures";
+		case Category::RenderTargets: return "Render Targets";
+		case Category::BVH: return "BVH";
+		case Category::RadianceCache: return "Radiance Cache";
+		default: return "Unknown";
+		}
+	}
+
+	void MemoryTracker::setUsage(Category category, uint64_t cpuBytes, uint64_t gpuBytes)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		Usage& u = usage[static_cast<size_t>(category)];
+		u.cpuBytes = cpuBytes;
+		u.gpuBytes = gpuBytes;
+		u.peakCpuBytes = std::max(u.peakCpuBytes, cpuBytes);
+		u.peakGpuBytes = std::max(u.peakGpuBytes, gpuBytes);
+		checkBudget(category, u);
+	}
+
+	void MemoryTracker::setBudget(Category category, uint64_t bytes)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		Usage& u = usage[static_cast<size_t>(category)];
+		u.budgetBytes = bytes;
+		checkBudget(category, u);
+	}
+
+	MemoryTracker::Usage MemoryTracker::getUsage(Category category)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return usage[static_cast<size_t>(category)];
+	}
+
+	void MemoryTracker::checkBudget(Category category, Usage& u)
+	{
+		// Only warn when the budget is first exceeded, not every time usage is reported while over it
+		const uint64_t total = u.cpuBytes + u.gpuBytes;
+		const bool over = u.budgetBytes > 0 && total > u.budgetBytes;
+		if (over && !u.overBudget) {
+			logWarning(std::string(getCategoryName(category)) + " memory is over budget (" + toMB(total) + " of " + toMB(u.budgetBytes) + ")");
+		}
+		u.overBudget = over;
+	}
+
+	std::string MemoryTracker::toJson()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		std::string json = "{\n";
+		for (size_t i = 0; i < usage.size(); i++) {
+			const Usage& u = usage[i];
+			json += "\t\"" + std::string(getCategoryName(static_cast<Category>(i))) + "\": {";
+			json += " \"cpuBytes\": " + std::to_string(u.cpuBytes);
+			json += ", \"gpuBytes\": " + std::to_string(u.gpuBytes);
+			json += ", \"peakCpuBytes\": " + std::to_string(u.peakCpuBytes);
+			json += ", \"peakGpuBytes\": " + std::to_string(u.peakGpuBytes);
+			json += ", \"budgetBytes\": " + std::to_string(u.budgetBytes);
+			json += ", \"overBudget\": " + std::string(u.overBudget ? "true" : "false");
+			json += i + 1 < usage.size() ? " },\n" : " }\n";
+		}
+		return json + "}\n";
+	}
+
+	bool MemoryTracker::dumpJson(const std::string& filename)
+	{
+		std::ofstream file(filename);
+		if (!file) {
+			logWarning("Failed to open " + filename + " for writing");
+			return false;
+		}
+		file << toJson();
+		logInfo("Wrote memory report to " + filename);
+		return true;
+	}
+
+	void MemoryTracker::renderUI(Gui::Widgets& widget)
+	{
+		uint64_t totalCpu = 0;
+		uint64_t totalGpu = 0;
+		for (size_t i = 0; i < usage.size(); i++) {
+			const Category category = static_cast<Category>(i);
+			const Usage u = getUsage(category);
+			totalCpu += u.cpuBytes;
+			totalGpu += u.gpuBytes;
+
+			const std::string name = getCategoryName(category);
+			widget.text(
+				name + ": CPU " + toMB(u.cpuBytes) + " (peak " + toMB(u.peakCpuBytes) + "), GPU " + toMB(u.gpuBytes) + " (peak " + toMB(u.peakGpuBytes) + ")" +
+				(u.overBudget ? " OVER BUDGET" : "")
+			);
+
+			int budgetMB = static_cast<int>(u.budgetBytes / (1024 * 1024));
+			if (widget.var((name + " Budget (MB, 0 for none)").c_str(), budgetMB, 0, 1 << 20)) setBudget(category, static_cast<uint64_t>(budgetMB) * 1024 * 1024);
+		}
+
+		widget.text("Total: CPU " + toMB(totalCpu) + ", GPU " + toMB(totalGpu));
+		if (widget.button("Dump to JSON")) dumpJson(getExecutableDirectory() + "/GModDXR_memory.json");
+	}
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "Falcor.h"
+
+namespace GModDXR
+{
+	/*
+		Attributes CPU and GPU memory to the module's subsystems, tracking current and peak usage against optional budgets
+
+		Usage is reported as snapshots by whoever owns the memory (replacing the category's previous value),
+		so it's shared by the Lua thread (capture) and the render thread (everything else)
+	*/
+	class MemoryTracker
+	{
+	public:
+		enum class Category
+		{
+			Capture,       // CPU copies of captured entity and world geometry
+			Geometry,      // Scene vertex and index data
+			Textures,      // Streamed material textures and the decoded start mip cache
+			RenderTargets, // Screen sized buffers
+			BVH,           // Acceleration structures
+			RadianceCache, // World space radiance cache cells
+			Count
+		};
+
+		struct Usage
+		{
+			uint64_t cpuBytes = 0;
+			uint64_t gpuBytes = 0;
+			uint64_t peakCpuBytes = 0;
+			uint64_t peakGpuBytes = 0;
+			uint64_t budgetBytes = 0; // Applies to CPU + GPU, 0 for no budget
+			bool overBudget = false;
+		};
+
+		static MemoryTracker& get();
+		static const char* getCategoryName(Category category);
+
+		void setUsage(Category category, uint64_t cpuBytes, uint64_t gpuBytes);
+		void setBudget(Category category, uint64_t bytes);
+		Usage getUsage(Category category);
+
+		std::string toJson();
+		bool dumpJson(const std::string& filename);
+		void renderUI(Falcor::Gui::Widgets& widget);
+
+	private:
+		MemoryTracker() = default;
+
+		std::mutex mutex;
+		std::array<Usage, static_cast<size_t>(Category::Count)> usage;
+
+		void checkBudget(Category category, Usage& u);
+	};
+}
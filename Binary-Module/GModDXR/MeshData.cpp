@@ -0,0 +1,134 @@
+#include "MeshData.h"
+#include "SceneCache.h"
+#include "glm/gtc/packing.hpp"
+
+namespace GModDXR
+{
+	using namespace Falcor;
+
+	MeshData::SharedPtr MeshData::create(
+		const std::string& name,
+		std::vector<float3> positions, std::vector<float3> normals, std::vector<float2> texCoords,
+		bool quantise, bool flipWinding
+	) {
+		SharedPtr pData = SharedPtr(new MeshData());
+		pData->name = name;
+		pData->vertexCount = positions.size();
+		pData->quantised = quantise;
+		pData->flipWinding = flipWinding;
+
+		if (!quantise) {
+			pData->positions = std::move(positions);
+			pData->normals = std::move(normals);
+			pData->texCoords = std::move(texCoords);
+			return pData;
+		}
+
+		// Spatially ordered triangles keep each block's bounds, and so its quantisation step, small even in a map sized mesh
+		static_assert(sizeof(float3) == 3 * sizeof(float), "Positions are read as xyz triples");
+		const std::vector<uint32_t> order = getSpatialTriangleOrder(reinterpret_cast<const float*>(positions.data()), positions.size());
+		std::vector<float3> ordered(order.size() * 3);
+		for (size_t t = 0; t < order.size(); t++) {
+			for (size_t k = 0; k < 3; k++) ordered[t * 3 + k] = positions[order[t] * 3 + k];
+		}
+
+		pData->vertexCount = ordered.size();
+		pData->packed.resize(ordered.size());
+		pData->blocks.resize(getPackedBlockCount(ordered.size()));
+		for (size_t block = 0; block < pData->blocks.size(); block++) {
+			const size_t first = block * kPackedBlockVertices;
+			const size_t count = std::min<size_t>(kPackedBlockVertices, ordered.size() - first);
+			packPositionBlock(reinterpret_cast<const float*>(ordered.data() + first), count, pData->packed.data() + first, pData->blocks[block]);
+		}
+
+		for (size_t i = 0; i < ordered.size(); i++) {
+			PackedVertex& v = pData->packed[i];
+			const size_t source = order[i / 3] * 3 + i % 3;
+
+			float2 oct;
+			encodeOctahedral(normals[source].x, normals[source].y, normals[source].z, oct.x, oct.y);
+			v.normal[0] = floatToSnorm16(oct.x);
+			v.normal[1] = floatToSnorm16(oct.y);
+
+			const float2 uv = source < texCoords.size() ? texCoords[source] : float2(0.f);
+			v.texCoord[0] = static_cast<uint16_t>(glm::packHalf1x16(uv.x));
+			v.texCoord[1] = static_cast<uint16_t>(glm::packHalf1x16(uv.y));
+		}
+
+		return pData;
+	}
+
+	MeshData::SharedPtr MeshData::createQuantised(
+		const std::string& name,
+		std::vector<PackedVertex> packed, std::vector<PackedBlock> blocks,
+		bool flipWinding
+	) {
+		SharedPtr pData = SharedPtr(new MeshData());
+		pData->name = name;
+		pData->vertexCount = packed.size();
+		pData->quantised = true;
+		pData->flipWinding = flipWinding;
+		pData->packed = std::move(packed);
+		pData->blocks = std::move(blocks);
+		return pData;
+	}
+
+	size_t MeshData::getByteSize() const
+	{
+		if (quantised) return packed.size() * sizeof(PackedVertex) + blocks.size() * sizeof(PackedBlock);
+		return positions.size() * sizeof(float3) + normals.size() * sizeof(float3) + texCoords.size() * sizeof(float2);
+	}
+
+	float3 MeshData::getPosition(size_t index) const
+	{
+		if (!quantised) return positions[index];
+
+		float3 position;
+		unpackPosition(packed[index], blocks[index / kPackedBlockVertices], &position.x);
+		return position;
+	}
+
+	float3 MeshData::getNormal(size_t index) const
+	{
+		if (!quantised) return normals[index];
+
+		const PackedVertex& v = packed[index];
+		float3 normal;
+		decodeOctahedral(snorm16ToFloat(v.normal[0]), snorm16ToFloat(v.normal[1]), normal.x, normal.y, normal.z);
+		return normal;
+	}
+
+	float2 MeshData::getTexCoord(size_t index) const
+	{
+		if (!quantised) return index < texCoords.size() ? texCoords[index] : float2(0.f);
+
+		const PackedVertex& v = packed[index];
+		return float2(glm::unpackHalf1x16(v.texCoord[0]), glm::unpackHalf1x16(v.texCoord[1]));
+	}
+
+	TriangleMesh::SharedPtr MeshData::createTriangleMesh() const
+	{
+		TriangleMesh::SharedPtr pMesh = TriangleMesh::create();
+		pMesh->setName(name);
+		for (size_t i = 0; i < vertexCount; i++) {
+			pMesh->addVertex(getPosition(i), getNormal(i), getTexCoord(i));
+			if (i % 3 == 2) {
+				if (flipWinding) pMesh->addTriangle(i, i - 1U, i - 2U);
+				else pMesh->addTriangle(i - 2U, i - 1U, i);
+			}
+		}
+		return pMesh;
+	}
+
+	uint64_t MeshData::computeHash() const
+	{
+		uint64_t hash = hashValue(flipWinding, hashValue(quantised, hashString(name)));
+		if (quantised) {
+			hash = hashBytes(blocks.data(), blocks.size() * sizeof(PackedBlock), hash);
+			return hashBytes(packed.data(), packed.size() * sizeof(PackedVertex), hash);
+		}
+		hash = hashBytes(positions.data(), positions.size() * sizeof(float3), hash);
+		hash = hashBytes(normals.data(), normals.size() * sizeof(float3), hash);
+		return hashBytes(texCoords.data(), texCoords.size() * sizeof(float2), hash);
+	}
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "Falcor.h"
+#include "VertexPacking.h"
+
+namespace GModDXR
+{
+	// Captured triangle soup (every 3 vertices is a triangle), optionally quantised in CPU memory (see PackedVertex), that's turned into a Falcor mesh when the scene is built
+	class MeshData
+	{
+	public:
+		using SharedPtr = std::shared_ptr<MeshData>;
+
+		// UVs may be empty, in which case every vertex gets (0, 0)
+		// Quantising reorders the triangles (see getSpatialTriangleOrder)
+		// Entities are captured with the opposite winding to the world, so flipWinding reverses each triangle's indices
+		static SharedPtr create(
+			const std::string& name,
+			std::vector<Falcor::float3> positions, std::vector<Falcor::float3> normals, std::vector<Falcor::float2> texCoords,
+			bool quantise, bool flipWinding
+		);
+
+		// Rebuilds a mesh from data that's already been quantised (as sent to the out of process renderer)
+		static SharedPtr createQuantised(
+			const std::string& name,
+			std::vector<PackedVertex> packed, std::vector<PackedBlock> blocks,
+			bool flipWinding
+		);
+
+		const std::string& getName() const { return name; }
+		size_t getVertexCount() const { return vertexCount; }
+		bool isQuantised() const { return quantised; }
+		bool getFlipWinding() const { return flipWinding; }
+		size_t getByteSize() const;
+
+		Falcor::float3 getPosition(size_t index) const;
+		Falcor::float3 getNormal(size_t index) const;
+		Falcor::float2 getTexCoord(size_t index) const;
+
+		Falcor::TriangleMesh::SharedPtr createTriangleMesh() const;
+		// Hash of everything createTriangleMesh uses, so built meshes can be reused between launches
+		uint64_t computeHash() const;
+
+		// Raw storage, only the arrays matching isQuantised() are filled
+		const std::vector<Falcor::float3>& getPositions() const { return positions; }
+		const std::vector<Falcor::float3>& getNormals() const { return normals; }
+		const std::vector<Falcor::float2>& getTexCoords() const { return texCoords; }
+		const std::vector<PackedVertex>& getPackedVertices() const { return packed; }
+		const std::vector<PackedBlock>& getPackedBlocks() const { return blocks; }
+
+	private:
+		MeshData() = default;
+
+		std::string name;
+		size_t vertexCount = 0;
+		bool quantised = false;
+		bool flipWinding = false;
+
+		std::vector<Falcor::float3> positions;
+		std::vector<Falcor::float3> normals;
+		std::vector<Falcor::float2> texCoords;
+
+		std::vector<PackedVertex> packed;
+		std::vector<PackedBlock> blocks; // One per kPackedBlockVertices packed vertices
+	};
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+
+namespace GModDXR
+{
+	/*
+		Decides which tiles are traced each frame and when a finished sweep (every tile traced once) is added to the accumulated
+		history, kept apart from the renderer (and Falcor) so it can be checked on its own (see Tools/ProgressiveScheduleTest.cpp)
+
+		When the camera moves and the whole screen fits in the frame's tile budget, the sweep restarts and the history is reprojected
+		to the new view (or reset without reprojection). When it doesn't fit, the history is reset but the sweep carries on, so the
+		traced output keeps updating a few tiles a frame while the camera moves. A sweep holding tiles from before the move is shown
+		but never accumulated
+	*/
+	class ProgressiveSchedule
+	{
+	public:
+		struct Frame
+		{
+			bool clearHistory = false; // Clear the accumulation buffers before tracing
+			bool clearOutput = false;  // Clear the traced output before tracing
+			uint32_t firstTile = 0;
+			uint32_t tiles = 0;        // Tiles to trace from firstTile
+		};
+
+		enum class SweepResult
+		{
+			Incomplete,
+			Discard,               // Complete but traced from more than one view
+			Accumulate,
+			ReprojectAndAccumulate // Warp the history to this sweep's view before adding it
+		};
+
+		/** Starts a frame.
+			\param[in] reset Settings or the scene changed, everything traced so far is thrown away.
+			\param[in] cameraMoved The view changed since the last frame.
+			\param[in] tileCount Tiles covering the screen, a change restarts like a reset.
+			\param[in] frameTiles Tiles that fit in this frame's budget (tileCount without tiling).
+		*/
+		Frame beginFrame(bool reset, bool cameraMoved, bool useReprojection, uint32_t tileCount, uint32_t frameTiles)
+		{
+			Frame frame;
+			if (reset || tileCount != this->tileCount) {
+				frame.clearHistory = true;
+				frame.clearOutput = true;
+				tileCursor = 0;
+				mixedSweep = false;
+			} else if (cameraMoved && frameTiles >= tileCount) {
+				// The whole screen is traced from the new view this frame
+				frame.clearHistory = !(useReprojection && historyValid);
+				reprojectionPending = !frame.clearHistory;
+				tileCursor = 0;
+				mixedSweep = false;
+			} else if (cameraMoved) {
+				// Keep sweeping so the screen keeps changing, the history would only be shown (frozen) until the sweep completes
+				frame.clearHistory = true;
+				mixedSweep = mixedSweep || tileCursor > 0;
+			}
+
+			if (frame.clearHistory) {
+				accumulatedSamples = 0;
+				historyValid = false;
+				reprojectionPending = false;
+			}
+
+			this->tileCount = tileCount;
+			frame.firstTile = tileCursor;
+			frame.tiles = std::min(frameTiles, tileCount - tileCursor);
+			tracingTiles = frame.tiles;
+			return frame;
+		}
+
+		// Call once the frame's tiles are traced, the history is valid again after accumulating
+		SweepResult endFrame(uint32_t samples)
+		{
+			tileCursor += tracingTiles;
+			if (tileCursor < tileCount) return SweepResult::Incomplete;
+
+			tileCursor = 0;
+			if (mixedSweep) {
+				mixedSweep = false;
+				return SweepResult::Discard;
+			}
+
+			const bool reproject = reprojectionPending;
+			reprojectionPending = false;
+			accumulatedSamples += samples;
+			historyValid = true;
+			return reproject ? SweepResult::ReprojectAndAccumulate : SweepResult::Accumulate;
+		}
+
+		// Warps the history in place at the end of the sweep, e.g. to fade out samples taken before a texture changed mip
+		void requestReprojection()
+		{
+			if (historyValid) reprojectionPending = true;
+		}
+
+		// The history is only shown once a sweep since the last reset has been accumulated, the traced tiles until then
+		bool showHistory() const { return accumulatedSamples > 0; }
+
+		uint32_t getAccumulatedSamples() const { return accumulatedSamples; }
+		uint32_t getTileCursor() const { return tileCursor; }
+
+	private:
+		uint32_t tileCursor = 0;
+		uint32_t tileCount = 1;
+		uint32_t tracingTiles = 0; // Tiles of the frame in progress
+		uint32_t accumulatedSamples = 0;
+		bool historyValid = false; // The history matches the previous sweep's view (its G-buffer)
+		bool reprojectionPending = false;
+		bool mixedSweep = false;
+	};
+}
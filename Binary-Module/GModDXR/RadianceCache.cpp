@@ -0,0 +1,123 @@
+#include "RadianceCache.h"
+
+namespace GModDXR
+{
+	using namespace Falcor;
+
+	static const Gui::DropdownList kModes = {
+		{ static_cast<uint32_t>(RadianceCache::Mode::Off), "Off" },
+		{ static_cast<uint32_t>(RadianceCache::Mode::On), "On" },
+		{ static_cast<uint32_t>(RadianceCache::Mode::Compare), "Bias Check (cached | uncached)" }
+	};
+
+	RadianceCache::SharedPtr RadianceCache::create(uint32_t capacity)
+	{
+		return SharedPtr(new RadianceCache(capacity));
+	}
+
+	RadianceCache::RadianceCache(uint32_t capacity) : capacity(capacity)
+	{
+		const ResourceBindFlags bindFlags = ResourceBindFlags::ShaderResource | ResourceBindFlags::UnorderedAccess;
+		pKeys = Buffer::createStructured(sizeof(uint32_t), capacity, bindFlags, Buffer::CpuAccess::None, nullptr, false);
+		pAccum = Buffer::createStructured(sizeof(uint4), capacity, bindFlags, Buffer::CpuAccess::None, nullptr, false);
+		pRadiance = Buffer::createStructured(sizeof(float4), capacity, bindFlags, Buffer::CpuAccess::None, nullptr, false);
+		pLastUsed = Buffer::createStructured(sizeof(uint32_t), capacity, bindFlags, Buffer::CpuAccess::None, nullptr, false);
+		pStats = Buffer::createStructured(sizeof(uint32_t), 3, bindFlags, Buffer::CpuAccess::None, nullptr, false);
+		for (auto& pBuffer : pStatsReadback) pBuffer = Buffer::create(3 * sizeof(uint32_t), ResourceBindFlags::None, Buffer::CpuAccess::Read);
+
+		pResolveProg = ComputeProgram::createFromFile("RadianceCacheResolve.cs.slang", "main");
+		pResolveVars = ComputeVars::create(pResolveProg->getReflector());
+		pResolveState = ComputeState::create();
+		pResolveState->setProgram(pResolveProg);
+
+		pResolveVars["gKeys"] = pKeys;
+		pResolveVars["gAccum"] = pAccum;
+		pResolveVars["gRadiance"] = pRadiance;
+		pResolveVars["gLastUsed"] = pLastUsed;
+		pResolveVars["gStats"] = pStats;
+	}
+
+	void RadianceCache::setShaderData(const ShaderVar& var) const
+	{
+		var["keys"] = pKeys;
+		var["accum"] = pAccum;
+		var["radiance"] = pRadiance;
+		var["lastUsed"] = pLastUsed;
+		var["stats"] = pStats;
+
+		var["mode"] = static_cast<uint32_t>(mode);
+		var["capacity"] = capacity;
+		var["frame"] = frame;
+		var["cellSize"] = cellSize;
+		var["minRoughness"] = minRoughness;
+		var["minWeight"] = minWeight;
+	}
+
+	void RadianceCache::update(RenderContext* pContext)
+	{
+		PROFILE("RadianceCache::update");
+
+		if (clearPending) {
+			pContext->clearUAV(pKeys->getUAV().get(), uint4(0));
+			pContext->clearUAV(pAccum->getUAV().get(), uint4(0));
+			pContext->clearUAV(pRadiance->getUAV().get(), uint4(0));
+			pContext->clearUAV(pLastUsed->getUAV().get(), uint4(0));
+			pContext->clearUAV(pStats->getUAV().get(), uint4(0));
+			liveCells = lookups = hits = 0;
+			clearPending = false;
+		}
+
+		if (mode == Mode::Off) return;
+
+		// Fold in what the last launch recorded (resolving at the start of the frame means this launch's lookups see it)
+		pResolveVars["PerFrameCB"]["gCapacity"] = capacity;
+		pResolveVars["PerFrameCB"]["gFrame"] = frame;
+		pResolveVars["PerFrameCB"]["gMaxWeight"] = maxWeight;
+		pResolveVars["PerFrameCB"]["gMaxAge"] = static_cast<uint32_t>(maxAge);
+		pContext->dispatch(pResolveState.get(), pResolveVars.get(), uint3(div_round_up(capacity, 256u), 1, 1));
+
+		// The readback buffer about to be reused holds the oldest stats, so read it before copying over it
+		const Buffer::SharedPtr& pCurrent = pStatsReadback[frame % kStatsLatency];
+		if (frame >= kStatsLatency) {
+			const uint32_t* pValues = static_cast<const uint32_t*>(pCurrent->map(Buffer::MapType::Read));
+			liveCells = pValues[0];
+			lookups = pValues[1];
+			hits = pValues[2];
+			pCurrent->unmap();
+		}
+		pContext->copyResource(pCurrent.get(), pStats.get());
+		pContext->clearUAV(pStats->getUAV().get(), uint4(0));
+
+		frame++;
+	}
+
+	bool RadianceCache::renderUI(Gui::Widgets& widget)
+	{
+		bool changed = false;
+
+		uint32_t modeValue = static_cast<uint32_t>(mode);
+		if (widget.dropdown("Mode", kModes, modeValue)) {
+			mode = static_cast<Mode>(modeValue);
+			changed = true;
+		}
+		if (widget.var("Cell Size", cellSize, 1.f, 1024.f, 1.f)) {
+			clear(); // Every key changes
+			changed = true;
+		}
+		if (widget.var("Min Roughness", minRoughness, 0.f, 1.f, 0.01f)) changed = true;
+		if (widget.var("Min Samples", minWeight, 1.f, 65536.f, 1.f, false, "%.0f")) changed = true;
+		widget.var("Max Samples", maxWeight, 1.f, 65536.f, 1.f, false, "%.0f");
+		widget.var("Evict After (frames)", maxAge, 1, 1 << 20);
+
+		widget.text("Cells: " + std::to_string(liveCells) + "/" + std::to_string(capacity));
+		const uint32_t hitPercent = lookups > 0 ? static_cast<uint32_t>(100ULL * hits / lookups) : 0;
+		widget.text("Hits: " + std::to_string(hits) + "/" + std::to_string(lookups) + " lookups (" + std::to_string(hitPercent) + "%)");
+
+		return changed;
+	}
+
+	uint64_t RadianceCache::getGpuBytes() const
+	{
+		return pKeys->getSize() + pAccum->getSize() + pRadiance->getSize() + pLastUsed->getSize() + pStats->getSize();
+	}
+}
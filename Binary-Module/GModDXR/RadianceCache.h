@@ -0,0 +1,72 @@
+#pragma once
+
+#include "Falcor.h"
+
+namespace GModDXR
+{
+	/*
+		World space radiance cache used to end paths early on rough surfaces
+
+		A GPU hash grid of cells keyed by position and coarse normal direction (see Shaders/RadianceCache.slang)
+		The path tracer records the radiance leaving each rough path vertex, update() folds the records into each cell's
+		running mean and evicts cells that haven't been used in a while
+		RadianceHashGrid is the same data structure on the CPU
+	*/
+	class RadianceCache
+	{
+	public:
+		using SharedPtr = std::shared_ptr<RadianceCache>;
+
+		// Must match the kRadianceCache* modes in RadianceCache.slang
+		enum class Mode : uint32_t
+		{
+			Off,
+			On,
+			Compare // Lookups on the left half of the screen only, so the cached result can be checked against the uncached one for bias
+		};
+
+		static SharedPtr create(uint32_t capacity);
+
+		void setShaderData(const Falcor::ShaderVar& var) const;
+		// Resolves the previous frame's records, must be called once per launch before tracing
+		void update(Falcor::RenderContext* pContext);
+		// Drops every cell at the next update, for when the scene changes under the cache
+		void clear() { clearPending = true; }
+		// Returns true if a setting changed that needs accumulation to restart
+		bool renderUI(Falcor::Gui::Widgets& widget);
+
+		Mode getMode() const { return mode; }
+		uint64_t getGpuBytes() const;
+
+	private:
+		RadianceCache(uint32_t capacity);
+
+		static const uint32_t kStatsLatency = 3; // Frames between writing the stats and reading them back
+
+		uint32_t capacity;
+		uint32_t frame = 0;
+		bool clearPending = true;
+
+		Mode mode = Mode::Off;
+		float cellSize = 16.f;
+		float minRoughness = 0.5f;
+		float minWeight = 32.f;   // Samples a cell needs before lookups use it
+		float maxWeight = 1024.f; // Cap on a cell's sample count, so it keeps following lighting changes
+		int maxAge = 600;         // Frames without use before a cell's evicted
+
+		Falcor::Buffer::SharedPtr pKeys;
+		Falcor::Buffer::SharedPtr pAccum;
+		Falcor::Buffer::SharedPtr pRadiance;
+		Falcor::Buffer::SharedPtr pLastUsed;
+		Falcor::Buffer::SharedPtr pStats;
+		std::array<Falcor::Buffer::SharedPtr, kStatsLatency> pStatsReadback;
+
+		uint32_t liveCells = 0;
+		uint32_t lookups = 0;
+		uint32_t hits = 0;
+
+		Falcor::ComputeProgram::SharedPtr pResolveProg;
+		Falcor::ComputeVars::SharedPtr pResolveVars;
+		Falcor::ComputeState::SharedPtr pResolveState;
+	};
+}
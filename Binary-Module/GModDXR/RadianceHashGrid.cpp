@@ -0,0 +1,89 @@
+#include "RadianceHashGrid.h"
+
+namespace GModDXR
+{
+	using namespace RadianceCacheMath;
+
+	RadianceHashGrid::RadianceHashGrid(const Settings& settings) : settings(settings)
+	{
+		clear();
+	}
+
+	void RadianceHashGrid::clear()
+	{
+		keys.assign(settings.capacity, kRadianceCacheEmpty);
+		accum.assign(settings.capacity, { 0, 0, 0, 0 });
+		radiance.assign(settings.capacity, { 0.f, 0.f, 0.f, 0.f });
+		lastUsed.assign(settings.capacity, 0);
+		liveCells = 0;
+	}
+
+	uint32_t RadianceHashGrid::computeKey(const Vec3& position, const Vec3& normal) const
+	{
+		return radianceCacheKey(
+			radianceCacheCellCoord(position[0], settings.cellSize), radianceCacheCellCoord(position[1], settings.cellSize), radianceCacheCellCoord(position[2], settings.cellSize),
+			radianceCacheNormalBin(normal[0], normal[1], normal[2])
+		);
+	}
+
+	uint32_t RadianceHashGrid::findSlot(uint32_t key, bool insert)
+	{
+		// Same search as RadianceCache::findSlot, where claiming a slot is a compare exchange
+		uint32_t slot = radianceCacheSlot(key, settings.capacity);
+		for (uint32_t i = 0; i < kRadianceCacheMaxProbes; i++) {
+			if (keys[slot] == key) return slot;
+			if (insert && keys[slot] == kRadianceCacheEmpty) {
+				keys[slot] = key;
+				return slot;
+			}
+			slot = (slot + 1) % settings.capacity;
+		}
+		return settings.capacity;
+	}
+
+	bool RadianceHashGrid::record(const Vec3& position, const Vec3& normal, const Vec3& sample)
+	{
+		const uint32_t slot = findSlot(computeKey(position, normal), true);
+		if (slot == settings.capacity) return false;
+
+		if (radianceCacheShouldSum(accum[slot][3]++)) {
+			for (int c = 0; c < 3; c++) accum[slot][c] += radianceCacheToFixed(sample[c]);
+		}
+		return true;
+	}
+
+	bool RadianceHashGrid::lookup(const Vec3& position, const Vec3& normal, Vec3& result)
+	{
+		const uint32_t slot = findSlot(computeKey(position, normal), false);
+		if (slot == settings.capacity || radiance[slot][3] < settings.minWeight) return false;
+
+		lastUsed[slot] = frame;
+		result = { radiance[slot][0], radiance[slot][1], radiance[slot][2] };
+		return true;
+	}
+
+	void RadianceHashGrid::resolve()
+	{
+		liveCells = 0;
+		for (uint32_t i = 0; i < settings.capacity; i++) {
+			if (keys[i] == kRadianceCacheEmpty) continue;
+
+			std::array<uint32_t, 4>& sums = accum[i];
+			std::array<float, 4>& cell = radiance[i];
+			if (sums[3] > 0) {
+				const float count = static_cast<float>(radianceCacheSummedCount(sums[3]));
+				const float alpha = radianceCacheBlend(cell[3], count, settings.maxWeight);
+				for (int c = 0; c < 3; c++) cell[c] += (radianceCacheFromFixed(sums[c]) / count - cell[c]) * alpha;
+				cell[3] = radianceCacheWeight(cell[3], count, settings.maxWeight);
+				sums = { 0, 0, 0, 0 };
+				lastUsed[i] = frame;
+			} else if (radianceCacheExpired(lastUsed[i], frame, settings.maxAge)) {
+				keys[i] = kRadianceCacheEmpty;
+				cell = { 0.f, 0.f, 0.f, 0.f };
+				continue;
+			}
+			liveCells++;
+		}
+		frame++;
+	}
+}
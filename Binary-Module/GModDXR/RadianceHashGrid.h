@@ -0,0 +1,72 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace GModDXR
+{
+	namespace RadianceCacheMath
+	{
+		using uint = uint32_t;
+		using std::floor;
+		using std::max;
+		using std::min;
+
+		#include "Shaders/RadianceCacheMath.slangh"
+	}
+
+	/*
+		CPU implementation of the radiance cache's hash grid, following the same rules as the GPU version
+		(RadianceCache.slang records and looks up, RadianceCacheResolve.cs.slang blends and evicts)
+
+		Cells are keyed by position (quantised to the cell size) and coarse normal direction and found by linear probing
+		Records are summed over a frame and folded into each cell's running mean by resolve(), which also evicts cells
+		that haven't been used in maxAge frames (freed slots can split a probe sequence, the stranded copy of a cell just ages out)
+
+		Doesn't depend on Falcor, so the cache behaviour can be checked without a GPU (see Tools/RadianceCacheTest.cpp)
+	*/
+	class RadianceHashGrid
+	{
+	public:
+		using Vec3 = std::array<float, 3>;
+
+		struct Settings
+		{
+			uint32_t capacity = 1 << 20;
+			float cellSize = 16.f;
+			float minWeight = 16.f;   // Samples a cell needs before lookups use it
+			float maxWeight = 1024.f; // Cap on a cell's sample count, so it keeps adapting
+			uint32_t maxAge = 300;    // Frames without use before a cell's evicted
+		};
+
+		explicit RadianceHashGrid(const Settings& settings);
+
+		// Adds a radiance sample to the cell containing the position, returns false if the cell couldn't be placed
+		bool record(const Vec3& position, const Vec3& normal, const Vec3& radiance);
+		// Returns false if the cell doesn't exist or hasn't got enough samples yet
+		bool lookup(const Vec3& position, const Vec3& normal, Vec3& radiance);
+		// Folds this frame's records into the cells, evicts stale ones and advances to the next frame
+		void resolve();
+		void clear();
+
+		const Settings& getSettings() const { return settings; }
+		uint32_t getFrame() const { return frame; }
+		uint32_t getLiveCells() const { return liveCells; }
+
+	private:
+		Settings settings;
+		uint32_t frame = 0;
+		uint32_t liveCells = 0;
+
+		std::vector<uint32_t> keys;
+		std::vector<std::array<uint32_t, 4>> accum;   // Fixed point radiance sums and sample count recorded this frame
+		std::vector<std::array<float, 4>> radiance;   // Resolved radiance and the number of samples behind it
+		std::vector<uint32_t> lastUsed;
+
+		uint32_t computeKey(const Vec3& position, const Vec3& normal) const;
+		uint32_t findSlot(uint32_t key, bool insert);
+	};
+}
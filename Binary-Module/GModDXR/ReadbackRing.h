@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <utility>
+
+namespace GModDXR
+{
+	/*
+		Fixed number of GPU readbacks in flight, collected in the order they were queued once they're a few frames old
+		(by which point their copies have finished, so collecting them doesn't wait on the GPU)
+
+		Nothing is ever dropped, queueing into a full ring collects the oldest readback early instead, waiting on it if it hasn't finished
+		Doesn't depend on Falcor so the ordering can be checked on its own (see Tools/FrameWriterTest.cpp)
+	*/
+	template<typename T>
+	class ReadbackRing
+	{
+	public:
+		ReadbackRing(size_t capacity, uint64_t latency) : capacity(capacity), latency(latency) {}
+
+		// collect is called with each readback (as T&&) when it's taken out of the ring
+		template<typename Collect>
+		void push(T item, Collect collect)
+		{
+			while (!entries.empty() && entries.size() >= capacity) collectFront(collect);
+			entries.push_back({ std::move(item), frame });
+		}
+
+		// Moves to the next frame and collects every readback that's now old enough
+		template<typename Collect>
+		void advance(Collect collect)
+		{
+			frame++;
+			while (!entries.empty() && frame - entries.front().second >= latency) collectFront(collect);
+		}
+
+		template<typename Collect>
+		void drain(Collect collect)
+		{
+			while (!entries.empty()) collectFront(collect);
+		}
+
+		size_t size() const { return entries.size(); }
+		size_t getEarlyCollections() const { return earlyCollections; }
+
+	private:
+		size_t capacity;
+		uint64_t latency;
+		uint64_t frame = 0;
+		size_t earlyCollections = 0; // Readbacks collected before they were old enough because the ring was full
+		std::deque<std::pair<T, uint64_t>> entries;
+
+		template<typename Collect>
+		void collectFront(Collect& collect)
+		{
+			if (frame - entries.front().second < latency) earlyCollections++;
+			T item = std::move(entries.front().first);
+			entries.pop_front();
+			collect(std::move(item));
+		}
+	};
+}
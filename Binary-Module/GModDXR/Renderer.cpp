@@ -1,20 +1,92 @@
 #include "Renderer.h"
+#include "SceneCache.h"
+#include "BlueNoise.h"
+#include "MemoryTracker.h"
 #include "Utils/Color/ColorUtils.h"
+#include <ctime>
+#include <filesystem>
 
 namespace GModDXR
 {
 	using namespace Falcor;
 	static const float4 kClearColour(0.361f, 0.361f, 0.361f, 1);
+	static HashCache<WorldCluster> worldClusterCache;
+	static HashCache<TriangleMesh::SharedPtr> entityMeshCache;
+
+	// Must match the SAMPLE_PATTERN_* defines in PathSampler.slang
+	static const Gui::DropdownList kSamplePatterns = {
+		{ 0, "Uniform" },
+		{ 1, "Owen-scrambled Sobol" },
+		{ 2, "Blue Noise" }
+	};
+	static const uint32_t kBlueNoiseSize = 64;
+	static const uint32_t kRadianceCacheCells = 1 << 20;
+	Material::SharedPtr createEntityMaterial(const float4& colour, const std::string& baseTexture)
+	{
+		Material::SharedPtr pMaterial = Material::create(baseTexture);
+		pMaterial->setShadingModel(ShadingModelMetalRough);
+		pMaterial->setRoughness(1.f); // Placeholder
+		pMaterial->setMetallic(0.f);  // Placeholder
+
+		pMaterial->setBaseColor(colour);
+
+		pMaterial->setSpecularTransmission(1.f - colour[3]);
+		if (colour[3] < 1.f) pMaterial->setDoubleSided(true); // If the object is transparent, set it to double sided (note that this will only handle baseColour alpha, not transparent textures)
+
+		pMaterial->setEmissiveColor(colour);
+		pMaterial->setEmissiveFactor(baseTexture == "lights/white" ? 1 : 0);
+
+		return pMaterial;
+	}
+
+	void runRenderer(
+		const WorldData* pWorldData, const float3& cameraPosition, const float3& cameraTarget,
+		std::vector<MeshData::SharedPtr>* pMeshes, std::vector<Material::SharedPtr>* pMaterials, std::vector<SceneBuilder::Node>* pNodes, std::vector<TextureDesc>* pTextures
+	) {
+		// Create renderer
+		IRenderer::UniquePtr pRenderer = std::make_unique<Renderer>();
+
+		// Get raw casted pointer to Renderer to access custom methods in the derived class
+		Renderer* pRendererRaw = reinterpret_cast<Renderer*>(pRenderer.get());
+		pRendererRaw->setWorldData(pWorldData);
+		pRendererRaw->setCameraDefaults(cameraPosition, cameraTarget);
+		pRendererRaw->setEntities(pMeshes, pMaterials, pNodes, pTextures);
+		pRendererRaw = nullptr;
+
+		// Create window config
+		SampleConfig config;
+		config.windowDesc.title = "Garry's Mod DXR";
+		config.windowDesc.resizableWindow = true;
+
+		Sample::run(config, pRenderer);
+	}
+
 	void Renderer::onGuiRender(Gui* pGui)
 	{
 		Gui::Window w(pGui, "GModDXR Settings", { 300, 400 }, { 10, 80 });
 
 		if (w.checkbox("Use Depth of Field", useDOF)) resetAccumulation = true;
+		if (w.var("Samples Per Launch", samplesPerLaunch, 1, 256)) resetAccumulation = true;
+		if (w.dropdown("Sample Pattern", kSamplePatterns, samplePattern)) {
+			pRaytraceProgram->addDefine("SAMPLE_PATTERN", std::to_string(samplePattern));
+			createRtVars();
+			resetAccumulation = true;
+		}
+		w.text("Accumulated Samples: " + std::to_string(progress.getAccumulatedSamples()));
 		if (w.var("Z Near", zNear, 0.f, std::numeric_limits<float>::max(), 0.1f) || w.var("Z Far", zFar, 0.1f, std::numeric_limits<float>::max(), 0.1f, true)) {
 			pScene->getCamera()->setDepthRange(zNear, zFar);
 			resetAccumulation = true;
 		}
 
+		if (auto group = w.group("Progressive Rendering")) {
+			if (group.checkbox("Tiled Dispatch", useTiling)) resetAccumulation = true;
+			group.var("Frame Budget (ms)", frameBudgetMs, 1.f, 1000.f, 1.f, false, "%.0f");
+			if (group.var("Tile Size", tileSize, 32, 2048, 32)) resetAccumulation = true;
+			group.checkbox("Reproject On Camera Motion", useReprojection);
+			group.var("Max History Samples", maxHistorySamples, 1, 1 << 16);
+			group.text("Tiles: " + std::to_string(progress.getTileCursor()) + "/" + std::to_string(tileCount) + " (" + std::to_string(static_cast<uint>(tilesPerFrame)) + " per frame)");
+		}
+
 		if (auto group = w.group("Colour Grading", true)) {
 			group.var("Exposure Compensation", exposureCompensation, -12.f, 12.f, 0.1f, false, "%.1f");
 			group.checkbox("Use White Balance", useWhiteBalance, false);
@@ -47,25 +119,53 @@ namespace GModDXR
 			group.checkbox("Early out", fxaaEarlyOut);
 		}
 
+		if (auto group = w.group("Frame Output")) {
+			if (group.button("Save Frame")) captureRequested = true;
+			group.var("Auto-save Every N Samples", autoSaveInterval, 0, 1 << 20);
+			group.text(
+				"Pending: " + std::to_string(pFrameWriter->getPendingCount()) + ", Written: " + std::to_string(pFrameWriter->getWrittenCount()) +
+				", Stalled: " + std::to_string(pFrameWriter->getStalledCount())
+			);
+		}
+
+		if (auto group = w.group("Memory")) MemoryTracker::get().renderUI(group);
+
+		if (auto group = w.group("Texture Streaming")) pTextureStreamer->renderUI(group);
+
+		if (auto group = w.group("World Clusters")) {
+			const WorldClusterStats& stats = worldClusterStats;
+			group.text("Clusters: " + std::to_string(stats.clusterCount) + " (" + std::to_string(stats.rebuilt) + " rebuilt this launch)");
+			group.text("Triangles: " + std::to_string(stats.totalTriangles) + " (" + std::to_string(stats.minTriangles) + " to " + std::to_string(stats.maxTriangles) + " per cluster)");
+			group.text("Bounds Overlap: " + std::to_string(static_cast<int>(stats.overlapPercent)) + "%");
+			group.text("Clipped Triangles: " + std::to_string(stats.clippedTriangles));
+			group.text("Build Time: " + std::to_string(static_cast<int>(stats.buildMs)) + "ms");
+		}
+
+		if (auto group = w.group("Radiance Cache")) {
+			if (pRadianceCache->renderUI(group)) resetAccumulation = true;
+		}
+
 		if (auto sceneGroup = w.group("Scene", true)) pScene->renderUI(w);
 	}
 
 	void Renderer::loadScene(RenderContext* pRenderContext, const Fbo* pTargetFbo)
 	{
 		// Create the scene
-		pBuilder = SceneBuilder::create();
+		// The world clusters all share one material, without these flags Falcor would merge them back into a single mesh and BLAS
+		pBuilder = SceneBuilder::create(SceneBuilder::Flags::Default | SceneBuilder::Flags::DontMergeMeshes | SceneBuilder::Flags::RTDontMergeStatic);
 
 		DirectionalLight::SharedPtr pSun = DirectionalLight::create("Sun");
 		pSun->setWorldDirection(pWorldData->sunDirection);
 		pBuilder->addLight(pSun);
 
-		// Load the game world into the scene
-		TriangleMesh::SharedPtr pWorld = TriangleMesh::create();
-		pWorld->setName("World");
-		for (size_t i = 0; i < pWorldData->length; i++) {
-			pWorld->addVertex(pWorldData->pPositions[i], pWorldData->pNormals[i], float2(0.f, 0.f));
-			if (i % 3 == 2) pWorld->addTriangle(i - 2U, i - 1U, i);
-		}
+		// Load the game world into the scene as spatial clusters, only rebuilding the ones that changed since last launch
+		worldClusterCache.beginLaunch();
+		const std::vector<WorldCluster> worldClusters = buildWorldClusters(*pWorldData->pGeometry, worldClusterCache, worldClusterStats);
+		logInfo(
+			"World split into " + std::to_string(worldClusterStats.clusterCount) + " clusters (" + std::to_string(worldClusterStats.rebuilt) + " rebuilt) in " +
+			std::to_string(static_cast<int>(worldClusterStats.buildMs)) + "ms, " + std::to_string(static_cast<int>(worldClusterStats.overlapPercent)) + "% bounds overlap, " +
+			std::to_string(worldClusterStats.clippedTriangles) + " triangles clipped at cluster boundaries"
+		);
 
 		Material::SharedPtr pWorldMat = Material::create("World");
 		pWorldMat->setShadingModel(ShadingModelMetalRough);
@@ -73,14 +173,33 @@ namespace GModDXR
 		pWorldMat->setRoughness(1.f);
 		pWorldMat->setMetallic(0.f);
 
-		SceneBuilder::Node worldNode;
-		worldNode.name = "World";
-		worldNode.transform = glm::identity<glm::mat4>();
+		// Every cluster is its own instance, so it gets its own BLAS
+		for (const WorldCluster& cluster : worldClusters) {
+			SceneBuilder::Node clusterNode;
+			clusterNode.name = cluster.pMesh->getName();
+			clusterNode.transform = glm::identity<glm::mat4>();
 
-		pBuilder->addMeshInstance(pBuilder->addNode(worldNode), pBuilder->addTriangleMesh(pWorld, pWorldMat));
+			pBuilder->addMeshInstance(pBuilder->addNode(clusterNode), pBuilder->addTriangleMesh(cluster.pMesh, pWorldMat));
+		}
 
 		// Iterate over all entities
+		// Textures are streamed, so they're only registered here and start out at a low mip
+		pTextureStreamer = TextureStreamer::create(2048ULL * 1024 * 1024);
+		pFrameWriter = FrameWriter::create();
+		pRadianceCache = RadianceCache::create(kRadianceCacheCells);
+		entityMeshCache.beginLaunch();
 		for (size_t i = 0; i < pMeshes->size(); i++) {
+			const Material::SharedPtr& pMaterial = pMaterials->at(i);
+
+			// Entity meshes are built once and reused while their captured data stays the same, like the world's clusters
+			const uint64_t meshHash = pMeshes->at(i)->computeHash();
+			TriangleMesh::SharedPtr pMesh;
+			if (!entityMeshCache.find(meshHash, pMesh)) {
+				pMesh = pMeshes->at(i)->createTriangleMesh();
+				entityMeshCache.insert(meshHash, pMesh);
+			}
+			pTextureStreamer->addMaterial(pMaterial, pMesh);
+
 			// Load image textures
 			// Diffuse
 			std::string filename = std::string("Overrides/materials/") + pTextures->at(i).baseColour;
@@ -88,36 +207,47 @@ namespace GModDXR
 			if (!findFileInDataDirectories(filename + ".png", fullPath)) {
 				filename = "Overrides/materials/gmoddxr_missingtexture";
 			}
-			pMaterials->at(i)->loadTexture(Material::TextureSlot::BaseColor, filename + ".png");
+			pTextureStreamer->addTexture(pMaterial, Material::TextureSlot::BaseColor, filename + ".png", true);
 
-			if (findFileInDataDirectories(filename + "_mrao.png", fullPath))
-				pBuilder->loadMaterialTexture(pMaterials->at(i), Material::TextureSlot::Specular, filename + "_mrao.png");
+			pTextureStreamer->addTexture(pMaterial, Material::TextureSlot::Specular, filename + "_mrao.png", false);
 
-			if (findFileInDataDirectories(filename + "_emission.png", fullPath)) {
-				pMaterials->at(i)->setEmissiveFactor(1.f);
-				pBuilder->loadMaterialTexture(pMaterials->at(i), Material::TextureSlot::Emissive, filename + "_emission.png");
-			}
+			if (pTextureStreamer->addTexture(pMaterial, Material::TextureSlot::Emissive, filename + "_emission.png", true))
+				pMaterial->setEmissiveFactor(1.f);
 
-			if (findFileInDataDirectories(filename + "_transmission.png", fullPath)) {
-				pMaterials->at(i)->setDoubleSided(true);
-				pBuilder->loadMaterialTexture(pMaterials->at(i), Material::TextureSlot::SpecularTransmission, filename + "_transmission.png");
-			}
+			if (pTextureStreamer->addTexture(pMaterial, Material::TextureSlot::SpecularTransmission, filename + "_transmission.png", false))
+				pMaterial->setDoubleSided(true);
 
 			// Normal map
 			filename = std::string("Overrides/materials/") + pTextures->at(i).normalMap;
-			if (!pTextures->at(i).normalMap.empty() && findFileInDataDirectories(filename + ".png", fullPath))
-				pBuilder->loadMaterialTexture(pMaterials->at(i), Material::TextureSlot::Normal, filename + ".png");
+			if (!pTextures->at(i).normalMap.empty())
+				pTextureStreamer->addTexture(pMaterial, Material::TextureSlot::Normal, filename + ".png", false);
 
-			pMaterials->at(i)->setAlphaMode(pTextures->at(i).alphatest ? AlphaModeMask : AlphaModeOpaque);
+			pMaterial->setAlphaMode(pTextures->at(i).alphatest ? AlphaModeMask : AlphaModeOpaque);
 
 			// Add mesh instance
-			pBuilder->addMeshInstance(pBuilder->addNode(pNodes->at(i)), pBuilder->addTriangleMesh(pMeshes->at(i), pMaterials->at(i)));
+			pBuilder->addMeshInstance(pBuilder->addNode(pNodes->at(i)), pBuilder->addTriangleMesh(pMesh, pMaterial));
 		}
+		logInfo(
+			"Entity meshes: " + std::to_string(entityMeshCache.getHits()) + " reused, " + std::to_string(entityMeshCache.getMisses()) + " built (" +
+			std::to_string(static_cast<int>(entityMeshCache.getReusePercent())) + "% reuse)"
+		);
+		pTextureStreamer->loadInitial();
 
 		pScene = pBuilder->getScene();
 		if (!pScene) logError("Failed to load scene");
 
+		// Check the clusters made it into the scene as separate meshes (how Falcor groups those into BLASes isn't exposed)
+		const size_t expectedMeshes = worldClusters.size() + pMeshes->size();
+		logInfo(
+			"Scene: " + std::to_string(pScene->getMeshCount()) + " meshes (" + std::to_string(worldClusters.size()) + " world clusters, " +
+			std::to_string(pMeshes->size()) + " entities), " + std::to_string(pScene->getMeshInstanceCount()) + " instances"
+		);
+		if (pScene->getMeshCount() != expectedMeshes) {
+			logWarning("Scene has " + std::to_string(pScene->getMeshCount()) + " meshes, expected " + std::to_string(expectedMeshes) + ", the builder merged some of them");
+		}
+
 		pCamera = pScene->getCamera();
+		pTextureStreamer->setScene(pScene);
 
 		// Update the controllers
 		float radius = pScene->getSceneBounds().radius();
@@ -147,19 +277,20 @@ namespace GModDXR
 		pSampleGenerator = SampleGenerator::create(SAMPLE_GENERATOR_UNIFORM);
 		pEmissiveSampler = EmissivePowerSampler::create(pRenderContext, pScene);
 
-		pRaytraceProgram = RtProgram::create(rtProgDesc, 80U);
+		pRaytraceProgram = RtProgram::create(rtProgDesc, 96U); // Largest payload is IndirectRayData, 84 bytes with the low discrepancy samplers
 		pRaytraceProgram->addDefines(pSampleGenerator->getDefines());
 		pRaytraceProgram->addDefines(pEmissiveSampler->getDefines());
 
 		Program::DefineList defines;
 		defines.add("_USE_LEGACY_SHADING_CODE", "0");
+		defines.add("SAMPLE_PATTERN", std::to_string(samplePattern));
 		pRaytraceProgram->addDefines(defines);
 
-		pRtVars = RtProgramVars::create(pRaytraceProgram, pScene);
+		// Blue noise mask for the blue noise sample pattern
+		std::vector<float> blueNoise = generateBlueNoise(kBlueNoiseSize);
+		pBlueNoise = Texture::create2D(kBlueNoiseSize, kBlueNoiseSize, ResourceFormat::R32Float, 1, 1, blueNoise.data(), ResourceBindFlags::ShaderResource);
 
-		auto pGlobalVars = pRtVars->getRootVar();
-		bool success = pSampleGenerator->setShaderData(pGlobalVars);
-		if (!success) logError("Failed to bind sample generator");
+		createRtVars();
 
 		pRaytraceProgram->setScene(pScene);
 
@@ -167,10 +298,110 @@ namespace GModDXR
 		pAccVars = ComputeVars::create(pAccProg->getReflector());
 		pAccState = ComputeState::create();
 
+		pReprojectProg = ComputeProgram::createFromFile("Reproject.cs.slang", "main");
+		pReprojectVars = ComputeVars::create(pReprojectProg->getReflector());
+		pReprojectState = ComputeState::create();
+		pReprojectState->setProgram(pReprojectProg);
+
 		pAntialiasPass = FullScreenPass::create("FXAA.slang");
 
 		pLuminancePass = FullScreenPass::create("Luminance.ps.slang");
 		pTonemapPass = FullScreenPass::create("Tonemap.ps.slang");
+
+		reportSceneMemory();
+	}
+
+	// Every mip, the post processing targets have full chains
+	static uint64_t textureBytes(const Texture::SharedPtr& pTexture)
+	{
+		if (!pTexture) return 0;
+		uint64_t bytes = 0;
+		for (uint32_t mip = 0; mip < pTexture->getMipCount(); mip++) {
+			bytes += static_cast<uint64_t>(pTexture->getWidth(mip)) * pTexture->getHeight(mip) * getFormatBytesPerBlock(pTexture->getFormat());
+		}
+		return bytes;
+	}
+
+	static uint64_t triangleMeshBytes(const TriangleMesh::SharedPtr& pMesh)
+	{
+		return pMesh->getVertices().size() * sizeof(TriangleMesh::Vertex) + pMesh->getIndices().size() * sizeof(uint32_t);
+	}
+
+	void Renderer::reportSceneMemory()
+	{
+		// The triangle meshes the builder was given outlive the scene build in the caches (including last launch's that weren't reused yet)
+		uint64_t cpuGeometry = 0;
+		worldClusterCache.forEach([&](const WorldCluster& cluster) { cpuGeometry += triangleMeshBytes(cluster.pMesh); });
+		entityMeshCache.forEach([&](const TriangleMesh::SharedPtr& pMesh) { cpuGeometry += triangleMeshBytes(pMesh); });
+
+		// Falcor doesn't expose its vertex buffers or acceleration structures, so they're sized from the mesh descs
+		// The BVH sizes come from the driver's prebuild info, which only depends on the counts and formats
+		GET_COM_INTERFACE(gpDevice->getApiHandle(), ID3D12Device5, pDevice5);
+
+		uint64_t gpuGeometry = 0;
+		uint64_t bvhBytes = 0;
+		for (uint32_t meshID = 0; meshID < pScene->getMeshCount(); meshID++) {
+			const MeshDesc& mesh = pScene->getMesh(meshID);
+			gpuGeometry += static_cast<uint64_t>(mesh.vertexCount) * sizeof(PackedStaticVertexData) + static_cast<uint64_t>(mesh.indexCount) * sizeof(uint32_t);
+
+			D3D12_RAYTRACING_GEOMETRY_DESC geometry = {};
+			geometry.Type = D3D12_RAYTRACING_GEOMETRY_TYPE_TRIANGLES;
+			geometry.Triangles.VertexFormat = DXGI_FORMAT_R32G32B32_FLOAT;
+			geometry.Triangles.VertexCount = mesh.vertexCount;
+			geometry.Triangles.VertexBuffer.StrideInBytes = sizeof(PackedStaticVertexData);
+			geometry.Triangles.IndexFormat = mesh.indexCount > 0 ? DXGI_FORMAT_R32_UINT : DXGI_FORMAT_UNKNOWN;
+			geometry.Triangles.IndexCount = mesh.indexCount;
+
+			D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS inputs = {};
+			inputs.Type = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL;
+			inputs.DescsLayout = D3D12_ELEMENTS_LAYOUT_ARRAY;
+			inputs.NumDescs = 1;
+			inputs.pGeometryDescs = &geometry;
+			inputs.Flags = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PREFER_FAST_TRACE;
+
+			D3D12_RAYTRACING_ACCELERATION_STRUCTURE_PREBUILD_INFO info = {};
+			pDevice5->GetRaytracingAccelerationStructurePrebuildInfo(&inputs, &info);
+			bvhBytes += info.ResultDataMaxSizeInBytes;
+		}
+
+		D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS tlasInputs = {};
+		tlasInputs.Type = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL;
+		tlasInputs.DescsLayout = D3D12_ELEMENTS_LAYOUT_ARRAY;
+		tlasInputs.NumDescs = pScene->getMeshInstanceCount();
+		tlasInputs.Flags = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PREFER_FAST_TRACE;
+
+		D3D12_RAYTRACING_ACCELERATION_STRUCTURE_PREBUILD_INFO tlasInfo = {};
+		pDevice5->GetRaytracingAccelerationStructurePrebuildInfo(&tlasInputs, &tlasInfo);
+		bvhBytes += tlasInfo.ResultDataMaxSizeInBytes + tlasInputs.NumDescs * sizeof(D3D12_RAYTRACING_INSTANCE_DESC);
+
+		MemoryTracker::get().setUsage(MemoryTracker::Category::Geometry, cpuGeometry, gpuGeometry);
+		MemoryTracker::get().setUsage(MemoryTracker::Category::BVH, 0, bvhBytes);
+	}
+
+	void Renderer::reportFrameMemory()
+	{
+		MemoryTracker::get().setUsage(MemoryTracker::Category::Textures, TextureStreamer::getCachedBytes(), pTextureStreamer->getResidentBytes());
+
+		uint64_t renderTargets = textureBytes(pRtOut) + textureBytes(pAccBufferSum) + textureBytes(pAccBufferCorr) + textureBytes(pAccOutput) + textureBytes(pBlueNoise);
+		renderTargets += textureBytes(pGBufferPosition) + textureBytes(pGBufferNormal) + textureBytes(pPrevGBufferPosition) + textureBytes(pPrevGBufferNormal);
+		renderTargets += textureBytes(pReprojectedSum) + textureBytes(pReprojectedCorr) + postProcessingBytes;
+		MemoryTracker::get().setUsage(MemoryTracker::Category::RenderTargets, 0, renderTargets);
+		MemoryTracker::get().setUsage(MemoryTracker::Category::RadianceCache, 0, pRadianceCache->getGpuBytes());
+	}
+
+	void Renderer::createRtVars()
+	{
+		// Changing program defines can change the layout of the vars, so they're recreated and everything rebound
+		pRtVars = RtProgramVars::create(pRaytraceProgram, pScene);
+
+		auto pGlobalVars = pRtVars->getRootVar();
+		bool success = pSampleGenerator->setShaderData(pGlobalVars);
+		if (!success) logError("Failed to bind sample generator");
+		pTextureStreamer->setShaderData(pGlobalVars);
+		pGlobalVars["gBlueNoise"] = pBlueNoise;
+
+		// The env map sampler is only bound when it's created
+		pEnvMapSampler = nullptr;
 	}
 
 	void Renderer::onLoad(RenderContext* pRenderContext)
@@ -187,13 +418,60 @@ namespace GModDXR
 		PROFILE("setPerFrameVars");
 		auto cb = pRtVars["PerFrameCB"];
 		cb["invView"] = glm::inverse(pCamera->getViewMatrix());
+		cb["cameraForward"] = glm::normalize(pCamera->getTarget() - pCamera->getPosition());
 		cb["viewportDims"] = float2(pTargetFbo->getWidth(), pTargetFbo->getHeight());
 		float fovY = focalLengthToFovY(pCamera->getFocalLength(), Camera::kDefaultFrameHeight);
 		cb["tanHalfFovY"] = std::tan(fovY * 0.5f);
 		cb["sampleIndex"] = sampleIndex;
+		cb["samplesPerLaunch"] = static_cast<uint>(samplesPerLaunch);
 		cb["useDOF"] = useDOF;
 		cb["kClearColour"] = kClearColour;
 		pRtVars->getRayGenVars()["gOutput"] = pRtOut;
+		pRtVars->getRayGenVars()["gGBufferPosition"] = pGBufferPosition;
+		pRtVars->getRayGenVars()["gGBufferNormal"] = pGBufferNormal;
+	}
+
+	uint Renderer::computeTileBudget(uint remainingTiles)
+	{
+		// Scale last frame's tile count by how far its frame time was from the budget
+		// Growth is clamped so a single cheap frame (e.g. all sky) can't blow the next one out
+		const float lastFrameMs = static_cast<float>(gpFramework->getFrameRate().getLastFrameTime());
+		if (lastFrameMs > 0.f) tilesPerFrame *= std::clamp(frameBudgetMs / lastFrameMs, 0.5f, 2.f);
+		tilesPerFrame = std::clamp(tilesPerFrame, 1.f, static_cast<float>(tileCount));
+
+		return std::min(static_cast<uint>(tilesPerFrame), remainingTiles);
+	}
+
+	void Renderer::reprojectHistory(RenderContext* pContext, const uint2& resolution)
+	{
+		PROFILE("reprojectHistory");
+		pReprojectVars["PerFrameCB"]["gPrevViewProj"] = prevViewProj;
+		pReprojectVars["PerFrameCB"]["gResolution"] = resolution;
+		pReprojectVars["PerFrameCB"]["gMaxHistory"] = static_cast<float>(maxHistorySamples);
+		pReprojectVars["gPosition"] = pGBufferPosition;
+		pReprojectVars["gNormal"] = pGBufferNormal;
+		pReprojectVars["gPrevPosition"] = pPrevGBufferPosition;
+		pReprojectVars["gPrevNormal"] = pPrevGBufferNormal;
+		pReprojectVars["gHistorySum"] = pAccBufferSum;
+		pReprojectVars["gHistoryCorrection"] = pAccBufferCorr;
+		pReprojectVars["gSumBuffer"] = pReprojectedSum;
+		pReprojectVars["gCorrectionBuffer"] = pReprojectedCorr;
+
+		uint3 numGroups = div_round_up(uint3(resolution.x, resolution.y, 1u), pReprojectProg->getReflector()->getThreadGroupSize());
+		pContext->dispatch(pReprojectState.get(), pReprojectVars.get(), numGroups);
+
+		// The warped history becomes what the accumulation pass adds to
+		std::swap(pAccBufferSum, pReprojectedSum);
+		std::swap(pAccBufferCorr, pReprojectedCorr);
+	}
+
+	bool Renderer::hasMaterialUpdates(const std::unordered_set<const Material*>* pIgnored) const
+	{
+		for (uint32_t materialID = 0; materialID < pScene->getMaterialCount(); materialID++) {
+			const Material::SharedPtr& pMaterial = pScene->getMaterial(materialID);
+			if (pMaterial->getUpdates() != Material::UpdateFlags::None && !(pIgnored && pIgnored->count(pMaterial.get()))) return true;
+		}
+		return false;
 	}
 
 	void Renderer::renderRT(RenderContext* pContext, const Fbo* pTargetFbo)
@@ -203,47 +481,89 @@ namespace GModDXR
 
 		const uint2 resolution = uint2(pTargetFbo->getWidth(), pTargetFbo->getHeight());
 
-		pContext->clearUAV(pRtOut->getUAV().get(), kClearColour);
-		pScene->raytrace(pContext, pRaytraceProgram.get(), pRtVars, uint3(resolution, 1));
-
-		// Accumulation pass (temporal denoising)
+		// Accumulation reset (checked before tracing so a partially traced frame is restarted)
 		// Reset code taken from Falcor's accumulation render pass (designed for use in mogwai)
 		auto sceneUpdates = pScene->getUpdates();
+
+		// Streaming a texture to another mip changes its material, but not what it looks like enough to throw the image or cache away
+		// The history is clamped (reprojected in place) so samples taken at the old mip fade out, without reprojection the swap resets
+		// like any other material change, as does a frame where anything else edited a material
+		if (!materialsEdited && !pTextureStreamer->getSwappedMaterials().empty() && useReprojection) {
+			sceneUpdates = sceneUpdates & ~Scene::UpdateFlags::MaterialsChanged;
+			progress.requestReprojection();
+		}
+
+		bool cameraMoved = false;
 		if ((sceneUpdates & ~Scene::UpdateFlags::CameraPropertiesChanged) != Scene::UpdateFlags::None) {
 			resetAccumulation = true;
+			pRadianceCache->clear(); // Cached lighting is world space, so it survives camera changes but nothing else
 		} else if (is_set(sceneUpdates, Scene::UpdateFlags::CameraPropertiesChanged)) {
 			auto excluded = Camera::Changes::Jitter | Camera::Changes::History;
-			auto cameraChanges = pScene->getCamera()->getChanges();
-			if ((cameraChanges & ~excluded) != Camera::Changes::None) resetAccumulation = true;
+			cameraMoved = (pScene->getCamera()->getChanges() & ~excluded) != Camera::Changes::None;
 		}
 
-		if (resetAccumulation) {
+		// Trace the frame in tiles, continuing from wherever the last frame stopped
+		// With tiling disabled the whole screen is a single tile
+		const uint2 tileDims = useTiling ? glm::min(uint2(tileSize), resolution) : resolution;
+		const uint2 tileGrid = div_round_up(resolution, tileDims);
+		tileCount = tileGrid.x * tileGrid.y;
+
+		// A moved camera keeps whatever history still lines up when the whole screen can be traced this frame, see ProgressiveSchedule
+		const uint frameTiles = useTiling ? computeTileBudget(tileCount) : tileCount;
+		const ProgressiveSchedule::Frame frame = progress.beginFrame(resetAccumulation, cameraMoved, useReprojection, tileCount, frameTiles);
+		resetAccumulation = false;
+
+		if (frame.clearHistory) {
 			pContext->clearUAV(pAccBufferSum->getUAV().get(), float4(0.f));
 			pContext->clearUAV(pAccBufferCorr->getUAV().get(), float4(0.f));
-			accumulatingSince = sampleIndex;
-			resetAccumulation = false;
+			lastAutoSave = 0;
 		}
+		// Tiles from the last sweep stay on screen until they're traced again
+		if (frame.clearOutput) pContext->clearUAV(pRtOut->getUAV().get(), kClearColour);
 
-		Texture::SharedPtr pPostProcessingOutput = Texture::create2D(
-			resolution.x, resolution.y,
-			ResourceFormat::RGBA16Float, 1, 1, nullptr,
-			ResourceBindFlags::UnorderedAccess | ResourceBindFlags::ShaderResource
-		);
+		pRadianceCache->update(pContext);
+		pRadianceCache->setShaderData(pRtVars["PerFrameCB"]["radianceCache"]);
 
-		pAccVars["PerFrameCB"]["gSamples"] = sampleIndex - accumulatingSince;
-		pAccVars["PerFrameCB"]["gResolution"] = resolution;
-		pAccVars["gInput"] = pRtOut;
-		pAccVars["gOutput"] = pPostProcessingOutput;
-		pAccVars["gSumBuffer"] = pAccBufferSum;
-		pAccVars["gCorrectionBuffer"] = pAccBufferCorr;
+		for (uint tileIndex = frame.firstTile; tileIndex < frame.firstTile + frame.tiles; tileIndex++) {
+			const uint2 tile = uint2(tileIndex % tileGrid.x, tileIndex / tileGrid.x);
+			pRtVars["PerFrameCB"]["tileOffset"] = tile * tileDims;
+			pScene->raytrace(pContext, pRaytraceProgram.get(), pRtVars, uint3(tileDims, 1));
+		}
+
+		// Accumulation pass (temporal denoising)
+		// Only complete sweeps from a single view are accumulated, partial ones keep displaying the last accumulated result
+		const ProgressiveSchedule::SweepResult sweep = progress.endFrame(samplesPerLaunch);
+		if (sweep == ProgressiveSchedule::SweepResult::Accumulate || sweep == ProgressiveSchedule::SweepResult::ReprojectAndAccumulate) {
+			// Warp the history to the new view using this frame's primary hits, before adding the new samples to it
+			if (sweep == ProgressiveSchedule::SweepResult::ReprojectAndAccumulate) reprojectHistory(pContext, resolution);
+
+			pAccVars["PerFrameCB"]["gSampleWeight"] = static_cast<uint>(samplesPerLaunch);
+			pAccVars["PerFrameCB"]["gResolution"] = resolution;
+			pAccVars["gInput"] = pRtOut;
+			pAccVars["gOutput"] = pAccOutput;
+			pAccVars["gSumBuffer"] = pAccBufferSum;
+			pAccVars["gCorrectionBuffer"] = pAccBufferCorr;
+
+			uint3 numGroups = div_round_up(uint3(resolution.x, resolution.y, 1u), pAccProg->getReflector()->getThreadGroupSize());
+			pAccState->setProgram(pAccProg);
+			pContext->dispatch(pAccState.get(), pAccVars.get(), numGroups);
+
+			// Increment sample index
+			sampleIndex++;
+
+			// This frame's G-buffer describes the accumulated history from now on, the next frame traces into the other one
+			std::swap(pGBufferPosition, pPrevGBufferPosition);
+			std::swap(pGBufferNormal, pPrevGBufferNormal);
+			prevViewProj = pCamera->getViewProjMatrix();
+		}
 
-		uint3 numGroups = div_round_up(uint3(resolution.x, resolution.y, 1u), pAccProg->getReflector()->getThreadGroupSize());
-		pAccState->setProgram(pAccProg);
-		pContext->dispatch(pAccState.get(), pAccVars.get(), numGroups);
+		// Until the first sweep since the history was reset completes, show the tiles as they're traced
+		Texture::SharedPtr pPostProcessingOutput = progress.showHistory() ? pAccOutput : pRtOut;
 
 		Fbo::Desc fboDesc;
 		fboDesc.setColorTarget(0, ResourceFormat::RGBA32Float);
 		Fbo::SharedPtr pPostProcessingFbo = Fbo::create2D(resolution.x, resolution.y, fboDesc, 1, Fbo::kAttachEntireMipLevel);
+		postProcessingBytes = textureBytes(pPostProcessingFbo->getColorTexture(0));
 
 		// Antialiasing pass
 		if (antialiasToggle) {
@@ -262,6 +582,7 @@ namespace GModDXR
 			pAntialiasPass->execute(pContext, pPostProcessingFbo);
 			pPostProcessingOutput = pPostProcessingFbo->getColorTexture(0);
 			pPostProcessingFbo = Fbo::create2D(resolution.x, resolution.y, fboDesc, 1, Fbo::kAttachEntireMipLevel); // Redefine FBO to break link to texture ptr
+			postProcessingBytes += textureBytes(pPostProcessingFbo->getColorTexture(0));
 		}
 
 		// Luminance pass
@@ -283,9 +604,29 @@ namespace GModDXR
 		pCB["useLut"]              = useLut;
 		pCB["gColourTransform"]    = static_cast<float3x4>(whiteBalanceTransform * pow(2.f, exposureCompensation));
 		pTonemapPass->execute(pContext, std::make_shared<Fbo>(*pTargetFbo));
+	}
+
+	void Renderer::captureFrame(RenderContext* pContext, const Fbo* pTargetFbo)
+	{
+		PROFILE("captureFrame");
+		const uint accumulatedSamples = progress.getAccumulatedSamples();
+
+		// Auto-save whenever the sample count crosses a multiple of the interval (launches can add several samples at once)
+		if (autoSaveInterval > 0 && accumulatedSamples / autoSaveInterval > lastAutoSave / autoSaveInterval) captureRequested = true;
+
+		if (captureRequested && accumulatedSamples > 0) {
+			const std::string directory = getExecutableDirectory() + "/Captures";
+			std::filesystem::create_directories(directory);
+
+			const std::string stem = directory + "/GModDXR_" + std::to_string(std::time(nullptr)) + "_" + std::to_string(accumulatedSamples) + "spp";
+			pFrameWriter->capture(pContext, pAccOutput, stem + "_hdr.exr", Bitmap::FileFormat::ExrFile);
+			pFrameWriter->capture(pContext, pTargetFbo->getColorTexture(0), stem + ".png", Bitmap::FileFormat::PngFile);
+
+			lastAutoSave = accumulatedSamples;
+			captureRequested = false;
+		}
 
-		// Increment sample index
-		sampleIndex++;
+		pFrameWriter->update();
 	}
 
 	void Renderer::onFrameRender(RenderContext* pRenderContext, const Fbo::SharedPtr& pTargetFbo)
@@ -294,6 +635,11 @@ namespace GModDXR
 
 		if (pScene) {
 			pScene->getLightCollection(pRenderContext);
+			// Textures are streamed first so their material changes are part of this frame's scene updates
+			// Changes already pending were made elsewhere (e.g. the scene UI), as is any on a material the streamer didn't swap
+			materialsEdited = hasMaterialUpdates(nullptr);
+			pTextureStreamer->update(pRenderContext);
+			materialsEdited = materialsEdited || hasMaterialUpdates(&pTextureStreamer->getSwappedMaterials());
 			pScene->update(pRenderContext, gpFramework->getGlobalClock().getTime());
 
 			if (pScene->useEmissiveLights()) {
@@ -320,6 +666,8 @@ namespace GModDXR
 			}
 
 			renderRT(pRenderContext, pTargetFbo.get());
+			captureFrame(pRenderContext, pTargetFbo.get()); // Before the text and GUI are drawn over the target
+			reportFrameMemory();
 		}
 
 		TextRenderer::render(pRenderContext, gpFramework->getFrameRate().getMsg(), pTargetFbo, { 20, 20 });
@@ -349,6 +697,16 @@ namespace GModDXR
 		pRtOut = Texture::create2D(width, height, ResourceFormat::RGBA32Float, 1, 1, nullptr, ResourceBindFlags::UnorderedAccess | ResourceBindFlags::ShaderResource);
 		pAccBufferSum = Texture::create2D(width, height, ResourceFormat::RGBA32Float, 1, 1, nullptr, ResourceBindFlags::UnorderedAccess | ResourceBindFlags::ShaderResource);
 		pAccBufferCorr = Texture::create2D(width, height, ResourceFormat::RGBA32Float, 1, 1, nullptr, ResourceBindFlags::UnorderedAccess | ResourceBindFlags::ShaderResource);
+		pAccOutput = Texture::create2D(width, height, ResourceFormat::RGBA16Float, 1, 1, nullptr, ResourceBindFlags::UnorderedAccess | ResourceBindFlags::ShaderResource);
+		pReprojectedSum = Texture::create2D(width, height, ResourceFormat::RGBA32Float, 1, 1, nullptr, ResourceBindFlags::UnorderedAccess | ResourceBindFlags::ShaderResource);
+		pReprojectedCorr = Texture::create2D(width, height, ResourceFormat::RGBA32Float, 1, 1, nullptr, ResourceBindFlags::UnorderedAccess | ResourceBindFlags::ShaderResource);
+		pGBufferPosition = Texture::create2D(width, height, ResourceFormat::RGBA32Float, 1, 1, nullptr, ResourceBindFlags::UnorderedAccess | ResourceBindFlags::ShaderResource);
+		pGBufferNormal = Texture::create2D(width, height, ResourceFormat::RGBA16Float, 1, 1, nullptr, ResourceBindFlags::UnorderedAccess | ResourceBindFlags::ShaderResource);
+		pPrevGBufferPosition = Texture::create2D(width, height, ResourceFormat::RGBA32Float, 1, 1, nullptr, ResourceBindFlags::UnorderedAccess | ResourceBindFlags::ShaderResource);
+		pPrevGBufferNormal = Texture::create2D(width, height, ResourceFormat::RGBA16Float, 1, 1, nullptr, ResourceBindFlags::UnorderedAccess | ResourceBindFlags::ShaderResource);
+
+		// Buffers were recreated, so any partially traced frame is gone
+		resetAccumulation = true;
 	}
 
 	void Renderer::setWorldData(const WorldData* data)
@@ -362,7 +720,7 @@ namespace GModDXR
 		cameraStartTarget = target;
 	}
 
-	void Renderer::setEntities(std::vector<TriangleMesh::SharedPtr>* meshes, std::vector<Material::SharedPtr>* materials, std::vector<SceneBuilder::Node>* nodes, std::vector<TextureDesc>* textures)
+	void Renderer::setEntities(std::vector<MeshData::SharedPtr>* meshes, std::vector<Material::SharedPtr>* materials, std::vector<SceneBuilder::Node>* nodes, std::vector<TextureDesc>* textures)
 	{
 		pMeshes = meshes;
 		pMaterials = materials;
@@ -6,14 +6,19 @@
 #include "Utils/Sampling/SampleGenerator.h"
 #include "Experimental/Scene/Lights/EmissivePowerSampler.h"
 #include "Experimental/Scene/Lights/EnvMapSampler.h"
+#include "TextureStreamer.h"
+#include "MeshData.h"
+#include "FrameWriter.h"
+#include "RadianceCache.h"
+#include "WorldClusters.h"
+#include "ProgressiveSchedule.h"
 
 namespace GModDXR
 {
 	struct WorldData
 	{
-		uint32_t length;
-		std::vector<Falcor::float3> pPositions;
-		std::vector<Falcor::float3> pNormals;
+		uint64_t hash; // Content hash of the positions, used to avoid resending the world to the renderer process
+		MeshData::SharedPtr pGeometry;
 		Falcor::float3 sunDirection;
 	};
 
@@ -24,6 +29,15 @@ namespace GModDXR
 		bool alphatest;
 	};
 
+	// Builds the material for a captured entity submesh from its colour (including alpha) and base texture
+	Falcor::Material::SharedPtr createEntityMaterial(const Falcor::float4& colour, const std::string& baseTexture);
+
+	// Opens the renderer window for the given scene and blocks until it's closed (the pointers must outlive the call)
+	void runRenderer(
+		const WorldData* pWorldData, const Falcor::float3& cameraPosition, const Falcor::float3& cameraTarget,
+		std::vector<MeshData::SharedPtr>* pMeshes, std::vector<Falcor::Material::SharedPtr>* pMaterials, std::vector<Falcor::SceneBuilder::Node>* pNodes, std::vector<TextureDesc>* pTextures
+	);
+
 	class Renderer : public Falcor::IRenderer
 	{
 	public:
@@ -36,13 +50,16 @@ namespace GModDXR
 
 		void setWorldData(const WorldData* data);
 		void setCameraDefaults(const Falcor::float3 pos, const Falcor::float3 target);
-		void setEntities(std::vector<Falcor::TriangleMesh::SharedPtr>* meshes, std::vector<Falcor::Material::SharedPtr>* materials, std::vector<Falcor::SceneBuilder::Node>* nodes, std::vector<TextureDesc>* textures);
+		void setEntities(std::vector<MeshData::SharedPtr>* meshes, std::vector<Falcor::Material::SharedPtr>* materials, std::vector<Falcor::SceneBuilder::Node>* nodes, std::vector<TextureDesc>* textures);
 
 	private:
 		Falcor::SceneBuilder::SharedPtr pBuilder;
 		Falcor::Scene::SharedPtr pScene;
+		WorldClusterStats worldClusterStats;
 
 		Falcor::Sampler::SharedPtr pLinearSampler;
+		TextureStreamer::SharedPtr pTextureStreamer;
+		RadianceCache::SharedPtr pRadianceCache;
 
 		Falcor::RtProgram::SharedPtr pRaytraceProgram;
 
@@ -51,8 +68,30 @@ namespace GModDXR
 		Falcor::ComputeState::SharedPtr pAccState;
 		Falcor::Texture::SharedPtr pAccBufferSum;
 		Falcor::Texture::SharedPtr pAccBufferCorr;
-		Falcor::uint accumulatingSince = 0;
+		Falcor::Texture::SharedPtr pAccOutput;
 		bool resetAccumulation = false;
+		bool materialsEdited = false; // A material was changed this frame by something other than texture streaming
+
+		// Camera motion reprojects the accumulated history instead of discarding it
+		Falcor::ComputeProgram::SharedPtr pReprojectProg;
+		Falcor::ComputeVars::SharedPtr pReprojectVars;
+		Falcor::ComputeState::SharedPtr pReprojectState;
+		Falcor::Texture::SharedPtr pGBufferPosition;     // Position and view depth of the primary hit
+		Falcor::Texture::SharedPtr pGBufferNormal;
+		Falcor::Texture::SharedPtr pPrevGBufferPosition; // As of the last accumulated frame
+		Falcor::Texture::SharedPtr pPrevGBufferNormal;
+		Falcor::Texture::SharedPtr pReprojectedSum;
+		Falcor::Texture::SharedPtr pReprojectedCorr;
+		Falcor::float4x4 prevViewProj;
+		bool useReprojection = true;
+		int maxHistorySamples = 256;
+
+		bool        useTiling = false;
+		float       frameBudgetMs = 33.f;
+		int         tileSize = 256;
+		float       tilesPerFrame = 1.f;
+		Falcor::uint tileCount = 1;
+		ProgressiveSchedule progress; // Which tiles are traced each frame and when they're accumulated
 
 		Falcor::FullScreenPass::SharedPtr pAntialiasPass;
 		bool                              antialiasToggle = true;
@@ -65,6 +104,7 @@ namespace GModDXR
 		Falcor::FullScreenPass::SharedPtr pTonemapPass;
 		Falcor::Texture::SharedPtr        pLutTexture;
 		bool                              useLut = false;
+		uint64_t                          postProcessingBytes = 0; // This frame's post processing targets (the FBOs are recreated every frame)
 
 		Falcor::Camera::SharedPtr pCamera;
 		Falcor::float3 cameraStartPos;
@@ -75,13 +115,21 @@ namespace GModDXR
 		Falcor::Texture::SharedPtr pRtOut;
 
 		Falcor::uint sampleIndex = 0;
+		int samplesPerLaunch = 1;
 		Falcor::SampleGenerator::SharedPtr pSampleGenerator;
+		uint32_t samplePattern = 0;
+		Falcor::Texture::SharedPtr pBlueNoise;
+
+		FrameWriter::UniquePtr pFrameWriter;
+		bool captureRequested = false;
+		int autoSaveInterval = 0; // Samples between automatic captures, 0 to disable
+		Falcor::uint lastAutoSave = 0;
 		Falcor::EmissiveLightSampler::SharedPtr pEmissiveSampler;
 		Falcor::EnvMapSampler::SharedPtr pEnvMapSampler;
 
 		const WorldData* pWorldData;
 
-		std::vector<Falcor::TriangleMesh::SharedPtr>* pMeshes;
+		std::vector<MeshData::SharedPtr>* pMeshes;
 		std::vector<Falcor::Material::SharedPtr>* pMaterials;
 		std::vector<Falcor::SceneBuilder::Node>* pNodes;
 		std::vector<TextureDesc>* pTextures;
@@ -95,8 +143,16 @@ namespace GModDXR
 		Falcor::float3 currentWhite = Falcor::float3(0.f);
 		Falcor::float3x3 colourTransform;
 
+		void createRtVars();
 		void setPerFrameVars(const Falcor::Fbo* pTargetFbo);
+		// True if a scene material has changes waiting for the next scene update, other than those in pIgnored
+		bool hasMaterialUpdates(const std::unordered_set<const Falcor::Material*>* pIgnored) const;
+		Falcor::uint computeTileBudget(Falcor::uint remainingTiles);
+		void reprojectHistory(Falcor::RenderContext* pContext, const Falcor::uint2& resolution);
 		void renderRT(Falcor::RenderContext* pContext, const Falcor::Fbo* pTargetFbo);
+		void captureFrame(Falcor::RenderContext* pContext, const Falcor::Fbo* pTargetFbo);
+		void reportSceneMemory();
+		void reportFrameMemory();
 		void loadScene(Falcor::RenderContext* pRenderContext, const Falcor::Fbo* pTargetFbo);
 	};
 }
\ No newline at end of file
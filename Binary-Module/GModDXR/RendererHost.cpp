@@ -0,0 +1,47 @@
+#include "Renderer.h"
+#include "SceneSnapshot.h"
+
+/*
+	Entrypoint for the out of process renderer (started by the module when launched with outOfProcess = true)
+
+	Usage: GModDXRHost.exe <channel name>
+	Receives a scene snapshot over the named SceneChannel, then renders it exactly like the in process renderer would
+*/
+static const uint32_t kReceiveTimeoutMs = 30000;
+
+int main(int argc, char** argv)
+{
+	if (argc < 2) {
+		Falcor::logError("Usage: GModDXRHost <channel name>");
+		return 1;
+	}
+
+	GModDXR::SceneChannel::UniquePtr pChannel = GModDXR::SceneChannel::open(argv[1]);
+	if (!pChannel) {
+		Falcor::logError(std::string("Failed to open scene channel ") + argv[1]);
+		return 1;
+	}
+
+	GModDXR::SceneSnapshot snapshot;
+	std::unordered_map<uint64_t, GModDXR::MeshData::SharedPtr> receivedMeshes;
+	const uint64_t start = GModDXR::SceneChannel::now();
+	if (!GModDXR::receiveSnapshot(*pChannel, snapshot, receivedMeshes, kReceiveTimeoutMs)) return 1;
+	Falcor::logInfo(
+		"Received " + std::to_string(snapshot.meshes.size()) + " instances of " + std::to_string(receivedMeshes.size()) + " meshes in " +
+		std::to_string((GModDXR::SceneChannel::now() - start) / 1000000) + "ms"
+	);
+
+	// Nothing else is sent once the scene is built, so the shared memory can go
+	pChannel = nullptr;
+
+	// Rebuild the entity data the module would've handed to the renderer thread
+	std::vector<Falcor::Material::SharedPtr> materials;
+	std::vector<Falcor::SceneBuilder::Node> nodes;
+	for (size_t i = 0; i < snapshot.meshes.size(); i++) {
+		materials.push_back(GModDXR::createEntityMaterial(snapshot.colours[i], snapshot.textures[i].baseColour));
+		nodes.push_back(Falcor::SceneBuilder::Node{ snapshot.nodeNames[i], glm::identity<glm::mat4>(), glm::identity<glm::mat4>() });
+	}
+
+	GModDXR::runRenderer(&snapshot.world, snapshot.cameraPosition, snapshot.cameraTarget, &snapshot.meshes, &materials, &nodes, &snapshot.textures);
+	return 0;
+}
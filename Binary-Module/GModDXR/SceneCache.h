@@ -0,0 +1,161 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace GModDXR
+{
+	// 64 bit FNV-1a, stable across launches so it can be used to key resources built in a previous one
+	static const uint64_t kHashSeed = 0xcbf29ce484222325ULL;
+
+	inline uint64_t hashBytes(const void* pData, size_t size, uint64_t hash = kHashSeed)
+	{
+		const uint8_t* pBytes = static_cast<const uint8_t*>(pData);
+		for (size_t i = 0; i < size; i++) {
+			hash ^= pBytes[i];
+			hash *= 0x100000001b3ULL;
+		}
+		return hash;
+	}
+
+	template<typename T>
+	inline uint64_t hashValue(const T& value, uint64_t hash = kHashSeed)
+	{
+		return hashBytes(&value, sizeof(T), hash);
+	}
+
+	inline uint64_t hashString(const std::string& str, uint64_t hash = kHashSeed)
+	{
+		// Include the length so adjacent strings can't shift characters between each other
+		return hashBytes(str.data(), str.size(), hashValue(str.size(), hash));
+	}
+
+	/*
+		Content hash keyed cache that only keeps what was used in the last launch
+
+		Calling beginLaunch moves everything into the previous generation, and anything not looked up again
+		before the next call is dropped, so the cache never holds more than one scene's worth of resources
+	*/
+	template<typename T>
+	class HashCache
+	{
+	public:
+		void beginLaunch()
+		{
+			previous = std::move(current);
+			current.clear();
+			hits = misses = 0;
+		}
+
+		// Returns true and copies the cached value into out if the hash was built last launch (or earlier this one)
+		bool find(uint64_t hash, T& out)
+		{
+			auto it = current.find(hash);
+			if (it != current.end()) {
+				out = it->second;
+				hits++;
+				return true;
+			}
+
+			it = previous.find(hash);
+			if (it != previous.end()) {
+				out = it->second;
+				current.emplace(hash, std::move(it->second));
+				previous.erase(it);
+				hits++;
+				return true;
+			}
+
+			misses++;
+			return false;
+		}
+
+		void insert(uint64_t hash, T value) { current[hash] = std::move(value); }
+
+		// Visits every entry still held, including last launch's ones that haven't been reused (yet)
+		template<typename F>
+		void forEach(F f) const
+		{
+			for (const auto& entry : current) f(entry.second);
+			for (const auto& entry : previous) f(entry.second);
+		}
+
+		size_t getHits() const { return hits; }
+		size_t getMisses() const { return misses; }
+		float getReusePercent() const { return hits + misses == 0 ? 0.f : 100.f * hits / (hits + misses); }
+
+	private:
+		std::unordered_map<uint64_t, T> current;
+		std::unordered_map<uint64_t, T> previous;
+		size_t hits = 0;
+		size_t misses = 0;
+	};
+
+	/*
+		Least recently used cache with a byte budget, safe to share between threads
+
+		Values are handed out as shared pointers, so one that's evicted while a caller still holds it stays valid until they're done
+		A single value larger than the budget is still kept (until anything else is inserted)
+	*/
+	template<typename T>
+	class LruCache
+	{
+	public:
+		explicit LruCache(uint64_t budgetBytes) : budgetBytes(budgetBytes) {}
+
+		std::shared_ptr<const T> find(uint64_t hash)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			auto it = lookup.find(hash);
+			if (it == lookup.end()) return nullptr;
+
+			entries.splice(entries.begin(), entries, it->second);
+			return it->second->value;
+		}
+
+		void insert(uint64_t hash, std::shared_ptr<const T> value, uint64_t bytes)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			auto existing = lookup.find(hash);
+			if (existing != lookup.end()) {
+				totalBytes -= existing->second->bytes;
+				entries.erase(existing->second);
+				lookup.erase(existing);
+			}
+
+			entries.push_front({ hash, std::move(value), bytes });
+			lookup[hash] = entries.begin();
+			totalBytes += bytes;
+
+			while (totalBytes > budgetBytes && entries.size() > 1) {
+				totalBytes -= entries.back().bytes;
+				lookup.erase(entries.back().hash);
+				entries.pop_back();
+			}
+		}
+
+		uint64_t getBytes() const
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			return totalBytes;
+		}
+
+	private:
+		struct Entry
+		{
+			uint64_t hash;
+			std::shared_ptr<const T> value;
+			uint64_t bytes;
+		};
+
+		uint64_t budgetBytes;
+		uint64_t totalBytes = 0;
+		std::list<Entry> entries; // Most recently used first
+		std::unordered_map<uint64_t, typename std::list<Entry>::iterator> lookup;
+		mutable std::mutex mutex;
+	};
+}
@@ -0,0 +1,254 @@
+#include "SceneChannel.h"
+#include <chrono>
+#include <cstring>
+#include <new>
+#include <thread>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace GModDXR
+{
+	static const uint32_t kMagic = 0x43445847; // "GXDC"
+	static const uint32_t kChannelVersion = 1;
+
+	static_assert(sizeof(SceneChannel::RecordHeader) == 32, "Record headers must stay a fixed size in the ring");
+	static_assert(std::atomic<uint64_t>::is_always_lock_free, "Shared memory atomics must be lock free to work across processes");
+
+	// Lives at the start of the mapping, the ring follows it
+	// Positions are running byte counts rather than offsets, so full and empty are distinguishable without a spare slot
+	struct SceneChannel::SharedHeader
+	{
+		std::atomic<uint32_t> magic;
+		uint32_t version;
+		uint64_t capacity;
+		alignas(64) std::atomic<uint64_t> writePos;
+		alignas(64) std::atomic<uint64_t> readPos;
+		alignas(64) std::atomic<uint32_t> closed;
+		std::atomic<uint32_t> consumerAttached;
+	};
+
+	static uint64_t alignUp(uint64_t value, uint64_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	static const uint64_t kRingOffset = 256; // Shared header size, rounded up to a multiple of the record alignment
+
+	uint64_t SceneChannel::now()
+	{
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+	}
+
+	SceneChannel::UniquePtr SceneChannel::create(const std::string& name, uint64_t capacity)
+	{
+		static_assert(sizeof(SharedHeader) <= kRingOffset, "Shared header must fit before the ring");
+
+		UniquePtr pChannel = UniquePtr(new SceneChannel());
+		pChannel->name = name;
+		pChannel->owner = true;
+		pChannel->capacity = alignUp(std::max(capacity, kRecordAlignment * 4), kRecordAlignment);
+		if (!pChannel->map(kRingOffset + pChannel->capacity, true)) return nullptr;
+
+		SharedHeader* pShared = new (pChannel->pMapping) SharedHeader();
+		pShared->version = kChannelVersion;
+		pShared->capacity = pChannel->capacity;
+		pShared->writePos.store(0);
+		pShared->readPos.store(0);
+		pShared->closed.store(0);
+		pShared->consumerAttached.store(0);
+		pShared->magic.store(kMagic, std::memory_order_release); // Last, so a consumer never sees a half initialised header
+
+		pChannel->pShared = pShared;
+		pChannel->pRing = static_cast<uint8_t*>(pChannel->pMapping) + kRingOffset;
+		return pChannel;
+	}
+
+	SceneChannel::UniquePtr SceneChannel::open(const std::string& name)
+	{
+		UniquePtr pChannel = UniquePtr(new SceneChannel());
+		pChannel->name = name;
+		if (!pChannel->map(0, false)) return nullptr;
+
+		SharedHeader* pShared = static_cast<SharedHeader*>(pChannel->pMapping);
+		if (pChannel->mappedSize < kRingOffset || pShared->magic.load(std::memory_order_acquire) != kMagic || pShared->version != kChannelVersion) return nullptr;
+		if (pChannel->mappedSize < kRingOffset + pShared->capacity) return nullptr;
+
+		pChannel->capacity = pShared->capacity;
+		pChannel->pShared = pShared;
+		pChannel->pRing = static_cast<uint8_t*>(pChannel->pMapping) + kRingOffset;
+		pShared->consumerAttached.store(1, std::memory_order_release);
+		return pChannel;
+	}
+
+	bool SceneChannel::map(uint64_t size, bool create)
+	{
+#ifdef _WIN32
+		const std::string mappingName = "Local\\" + name;
+		HANDLE hMapping = create
+			? CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, static_cast<DWORD>(size >> 32), static_cast<DWORD>(size), mappingName.c_str())
+			: OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, mappingName.c_str());
+		if (!hMapping) return false;
+		if (create && GetLastError() == ERROR_ALREADY_EXISTS) {
+			CloseHandle(hMapping);
+			return false;
+		}
+		pHandle = hMapping;
+
+		pMapping = MapViewOfFile(hMapping, FILE_MAP_ALL_ACCESS, 0, 0, static_cast<SIZE_T>(size));
+		if (!pMapping) return false;
+
+		MEMORY_BASIC_INFORMATION info = {};
+		VirtualQuery(pMapping, &info, sizeof(info));
+		mappedSize = create ? size : info.RegionSize;
+#else
+		const std::string shmName = "/" + name;
+		if (create) {
+			shm_unlink(shmName.c_str()); // Left behind if a previous producer crashed
+			fd = shm_open(shmName.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+			if (fd < 0 || ftruncate(fd, static_cast<off_t>(size)) != 0) return false;
+		} else {
+			fd = shm_open(shmName.c_str(), O_RDWR, 0600);
+			if (fd < 0) return false;
+
+			struct stat info;
+			if (fstat(fd, &info) != 0) return false;
+			size = static_cast<uint64_t>(info.st_size);
+		}
+		if (size == 0) return false;
+
+		void* pView = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (pView == MAP_FAILED) return false;
+		pMapping = pView;
+		mappedSize = size;
+#endif
+		return true;
+	}
+
+	SceneChannel::~SceneChannel()
+	{
+		if (pShared && !owner) pShared->consumerAttached.store(0, std::memory_order_release);
+
+#ifdef _WIN32
+		if (pMapping) UnmapViewOfFile(pMapping);
+		if (pHandle) CloseHandle(static_cast<HANDLE>(pHandle));
+#else
+		if (pMapping) munmap(pMapping, mappedSize);
+		if (fd >= 0) ::close(fd);
+		if (owner) shm_unlink(("/" + name).c_str());
+#endif
+	}
+
+	template<typename Pred>
+	bool SceneChannel::waitFor(Pred pred, uint32_t timeoutMs) const
+	{
+		// Spin briefly for low latency while the other side is keeping up, then back off to sleeping
+		const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+		for (uint32_t spin = 0; ; spin++) {
+			if (pred()) return true;
+			if (pShared->closed.load(std::memory_order_acquire)) return pred();
+
+			if (spin < 1024) {
+				std::this_thread::yield();
+			} else {
+				if (std::chrono::steady_clock::now() >= deadline) return false;
+				std::this_thread::sleep_for(std::chrono::microseconds(50));
+			}
+		}
+	}
+
+	uint8_t* SceneChannel::beginWrite(uint32_t type, uint64_t size, uint32_t timeoutMs)
+	{
+		if (size > getMaxPayloadSize() || type == kPaddingRecord) return nullptr;
+
+		const uint64_t recordSize = alignUp(sizeof(RecordHeader) + size, kRecordAlignment);
+		const uint64_t write = pShared->writePos.load(std::memory_order_relaxed);
+		const uint64_t offset = write % capacity;
+		const uint64_t padding = offset + recordSize > capacity ? capacity - offset : 0;
+		const uint64_t needed = padding + recordSize;
+
+		const bool ready = waitFor([&]() { return capacity - (write - pShared->readPos.load(std::memory_order_acquire)) >= needed; }, timeoutMs);
+		if (!ready || isClosed()) return nullptr;
+
+		if (padding > 0) {
+			RecordHeader* pPadding = reinterpret_cast<RecordHeader*>(pRing + offset);
+			pPadding->type = kPaddingRecord;
+			pPadding->size = padding - sizeof(RecordHeader);
+		}
+
+		RecordHeader* pHeader = reinterpret_cast<RecordHeader*>(pRing + (write + padding) % capacity);
+		pHeader->type = type;
+		pHeader->reserved = 0;
+		pHeader->size = size;
+		pHeader->sequence = sequence++;
+		pPendingHeader = pHeader;
+		pendingWrite = needed;
+		return reinterpret_cast<uint8_t*>(pHeader + 1);
+	}
+
+	void SceneChannel::endWrite()
+	{
+		pPendingHeader->sendTimeNs = now();
+		pShared->writePos.store(pShared->writePos.load(std::memory_order_relaxed) + pendingWrite, std::memory_order_release);
+		pPendingHeader = nullptr;
+		pendingWrite = 0;
+	}
+
+	bool SceneChannel::write(uint32_t type, const void* pData, uint64_t size, uint32_t timeoutMs)
+	{
+		uint8_t* pPayload = beginWrite(type, size, timeoutMs);
+		if (!pPayload) return false;
+		if (size > 0) std::memcpy(pPayload, pData, size);
+		endWrite();
+		return true;
+	}
+
+	const SceneChannel::RecordHeader* SceneChannel::beginRead(uint32_t timeoutMs)
+	{
+		while (true) {
+			const uint64_t read = pShared->readPos.load(std::memory_order_relaxed);
+			const bool ready = waitFor([&]() { return pShared->writePos.load(std::memory_order_acquire) != read; }, timeoutMs);
+			if (!ready) return nullptr;
+
+			const RecordHeader* pHeader = reinterpret_cast<const RecordHeader*>(pRing + read % capacity);
+			const uint64_t recordSize = alignUp(sizeof(RecordHeader) + pHeader->size, kRecordAlignment);
+			if (pHeader->type == kPaddingRecord) {
+				pShared->readPos.store(read + sizeof(RecordHeader) + pHeader->size, std::memory_order_release);
+				continue;
+			}
+
+			pendingRead = recordSize;
+			return pHeader;
+		}
+	}
+
+	void SceneChannel::endRead()
+	{
+		pShared->readPos.store(pShared->readPos.load(std::memory_order_relaxed) + pendingRead, std::memory_order_release);
+		pendingRead = 0;
+	}
+
+	void SceneChannel::close()
+	{
+		pShared->closed.store(1, std::memory_order_release);
+	}
+
+	bool SceneChannel::isClosed() const
+	{
+		return pShared->closed.load(std::memory_order_acquire) != 0;
+	}
+
+	bool SceneChannel::waitForConsumer(uint32_t timeoutMs)
+	{
+		return waitFor([this]() { return pShared->consumerAttached.load(std::memory_order_acquire) != 0; }, timeoutMs);
+	}
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace GModDXR
+{
+	/*
+		Single producer, single consumer ring buffer in named shared memory, used to feed the out of process renderer
+
+		Records are written and read in place (beginWrite returns a pointer into the ring to fill, beginRead one to read from),
+		so there's no staging copy on either side: a writer copies straight from its own memory into the ring, and a reader can copy straight out of it
+		into wherever the data ends up (the space is reused once endRead is called, so anything kept has to be copied out)
+		Records never wrap around the end of the ring, a padding record fills the gap instead
+
+		Doesn't depend on Falcor or Windows so the transport can be exercised between two processes on Linux (see Tools/ChannelBench.cpp)
+	*/
+	class SceneChannel
+	{
+	public:
+		using UniquePtr = std::unique_ptr<SceneChannel>;
+
+		struct RecordHeader
+		{
+			uint32_t type;
+			uint32_t reserved;
+			uint64_t size;       // Payload bytes following the header
+			uint64_t sendTimeNs; // From now(), set when the record is committed
+			uint64_t sequence;
+		};
+
+		static const uint32_t kPaddingRecord = 0; // Record type reserved by the channel
+		static const uint64_t kRecordAlignment = 64;
+
+		// Creates the shared memory (the producer's side), capacity is rounded up to the record alignment
+		static UniquePtr create(const std::string& name, uint64_t capacity);
+		// Attaches to shared memory created by another process (the consumer's side), returns nullptr if it doesn't exist
+		static UniquePtr open(const std::string& name);
+		~SceneChannel();
+
+		// Reserves space for a record and returns a pointer to its payload, or nullptr if the consumer didn't make room in time
+		uint8_t* beginWrite(uint32_t type, uint64_t size, uint32_t timeoutMs);
+		void endWrite();
+		bool write(uint32_t type, const void* pData, uint64_t size, uint32_t timeoutMs);
+
+		// Returns the next record (its payload follows the header), or nullptr on timeout or once closed and drained
+		const RecordHeader* beginRead(uint32_t timeoutMs);
+		void endRead();
+
+		// Either side can close the channel, which fails any waits on the other
+		void close();
+		bool isClosed() const;
+		bool waitForConsumer(uint32_t timeoutMs);
+
+		uint64_t getCapacity() const { return capacity; }
+		uint64_t getMaxPayloadSize() const { return capacity / 2 - sizeof(RecordHeader); }
+		const std::string& getName() const { return name; }
+
+		// Monotonic nanoseconds, comparable between processes on the same machine
+		static uint64_t now();
+
+	private:
+		struct SharedHeader;
+
+		SceneChannel() = default;
+
+		std::string name;
+		bool owner = false;
+		uint64_t capacity = 0;
+		uint64_t mappedSize = 0;
+		void* pMapping = nullptr;
+		void* pHandle = nullptr; // Windows file mapping handle
+		int fd = -1;             // POSIX shared memory descriptor
+
+		SharedHeader* pShared = nullptr;
+		uint8_t* pRing = nullptr;
+
+		RecordHeader* pPendingHeader = nullptr;
+		uint64_t pendingWrite = 0; // Bytes reserved by beginWrite (including padding before the record)
+		uint64_t pendingRead = 0;
+		uint64_t sequence = 0;
+
+		bool map(uint64_t size, bool create);
+		template<typename Pred>
+		bool waitFor(Pred pred, uint32_t timeoutMs) const;
+	};
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstdint>
+
+namespace GModDXR
+{
+	/*
+		Binary protocol spoken over a SceneChannel between the module and the out of process renderer
+
+		A launch is sent as:
+		- Hello
+		- Mesh + MeshChunk... for every mesh the renderer hasn't already been sent (the world first)
+		- Snapshot
+		- Instance for every entity submesh, referring to its mesh by content hash
+		- EndSnapshot
+		Meshes are keyed by the same content hashes as the relaunch caches, so repeated meshes are only sent once per renderer process
+		Every launch starts a new renderer process though, so in practice a launch sends its whole scene (submeshes shared between entities only once)
+
+		Every struct is a fixed size POD written straight into the ring, with any strings and vertex data following it
+		Vertex streams are split into chunks no bigger than the ring allows, and the renderer copies each one out of the ring into the mesh it's building
+		SceneStream.h writes and reads these messages
+	*/
+	namespace Protocol
+	{
+		static const uint32_t kVersion = 2;
+
+		enum MessageType : uint32_t
+		{
+			Hello = 1,
+			Mesh,
+			MeshChunk,
+			Snapshot,
+			Instance,
+			EndSnapshot,
+			Shutdown
+		};
+
+		enum MeshFlags : uint32_t
+		{
+			MeshQuantised = 1 << 0,
+			MeshFlipWinding = 1 << 1,
+			MeshHasTexCoords = 1 << 2
+		};
+
+		enum VertexStream : uint32_t
+		{
+			StreamPositions = 0, // float3
+			StreamNormals,       // float3
+			StreamTexCoords,     // float2
+			StreamPacked,        // PackedVertex (replaces the other three for quantised meshes)
+			StreamBlocks         // PackedBlock, one per kPackedBlockVertices vertices of a quantised mesh
+		};
+		static const uint32_t kStreamCount = 5;
+
+		inline uint32_t getStreamStride(uint32_t stream)
+		{
+			switch (stream) {
+			case StreamPositions: return 12;
+			case StreamNormals: return 12;
+			case StreamTexCoords: return 8;
+			case StreamPacked: return 14;
+			case StreamBlocks: return 24;
+			default: return 0;
+			}
+		}
+
+		struct HelloMessage
+		{
+			uint32_t version;
+			uint32_t padding;
+		};
+
+		// Followed by nameLength bytes of name
+		struct MeshMessage
+		{
+			uint64_t hash;
+			uint32_t vertexCount;
+			uint32_t flags;
+			uint32_t nameLength;
+			uint32_t padding;
+		};
+
+		// Followed by elementCount * getStreamStride(stream) bytes, elements are vertices except in StreamBlocks
+		struct MeshChunkMessage
+		{
+			uint64_t hash;
+			uint32_t stream;
+			uint32_t firstElement;
+			uint32_t elementCount;
+			uint32_t padding;
+		};
+
+		struct SnapshotMessage
+		{
+			uint64_t worldHash;
+			float cameraPosition[3];
+			float cameraTarget[3];
+			float sunDirection[3];
+			uint32_t instanceCount;
+		};
+
+		// Followed by the node name, base texture and normal map strings, in that order
+		struct InstanceMessage
+		{
+			uint64_t meshHash;
+			float colour[4];
+			uint32_t alphaTest;
+			uint32_t nameLength;
+			uint32_t baseTextureLength;
+			uint32_t normalMapLength;
+		};
+
+		static_assert(sizeof(MeshMessage) == 24 && sizeof(MeshChunkMessage) == 24 && sizeof(SnapshotMessage) == 48 && sizeof(InstanceMessage) == 40, "Protocol structs must match between builds");
+	}
+}
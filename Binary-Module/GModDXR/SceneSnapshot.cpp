@@ -0,0 +1,160 @@
+#include "SceneSnapshot.h"
+
+namespace GModDXR
+{
+	using namespace Falcor;
+
+	static_assert(sizeof(PackedVertex) == 14 && sizeof(PackedBlock) == 24 && sizeof(float3) == 12 && sizeof(float2) == 8, "Vertex streams are sent as raw memory");
+
+	static bool sendMeshData(SceneChannel& channel, uint64_t hash, const MeshData& mesh, uint32_t timeoutMs)
+	{
+		MeshStreams streams;
+		streams.header.hash = hash;
+		streams.header.vertexCount = static_cast<uint32_t>(mesh.getVertexCount());
+		streams.header.flags =
+			(mesh.isQuantised() ? Protocol::MeshQuantised : 0) |
+			(mesh.getFlipWinding() ? Protocol::MeshFlipWinding : 0) |
+			(!mesh.isQuantised() && !mesh.getTexCoords().empty() ? Protocol::MeshHasTexCoords : 0);
+		streams.name = mesh.getName();
+
+		if (mesh.isQuantised()) {
+			streams.pStreams[Protocol::StreamPacked] = mesh.getPackedVertices().data();
+			streams.pStreams[Protocol::StreamBlocks] = mesh.getPackedBlocks().data();
+		} else {
+			streams.pStreams[Protocol::StreamPositions] = mesh.getPositions().data();
+			streams.pStreams[Protocol::StreamNormals] = mesh.getNormals().data();
+			streams.pStreams[Protocol::StreamTexCoords] = mesh.getTexCoords().data();
+		}
+
+		return sendMesh(channel, streams, timeoutMs);
+	}
+
+	bool sendSnapshot(SceneChannel& channel, const SceneSnapshot& snapshot, std::unordered_set<uint64_t>& sentMeshes, uint32_t timeoutMs)
+	{
+		// Meshes first, so every instance's mesh is complete by the time it arrives
+		if (sentMeshes.insert(snapshot.world.hash).second && !sendMeshData(channel, snapshot.world.hash, *snapshot.world.pGeometry, timeoutMs)) return false;
+		for (size_t i = 0; i < snapshot.meshes.size(); i++) {
+			if (sentMeshes.insert(snapshot.meshHashes[i]).second && !sendMeshData(channel, snapshot.meshHashes[i], *snapshot.meshes[i], timeoutMs)) return false;
+		}
+
+		Protocol::SnapshotMessage message = {};
+		message.worldHash = snapshot.world.hash;
+		for (int axis = 0; axis < 3; axis++) {
+			message.cameraPosition[axis] = snapshot.cameraPosition[axis];
+			message.cameraTarget[axis] = snapshot.cameraTarget[axis];
+			message.sunDirection[axis] = snapshot.world.sunDirection[axis];
+		}
+		message.instanceCount = static_cast<uint32_t>(snapshot.meshes.size());
+		if (!sendSnapshotHeader(channel, message, timeoutMs)) return false;
+
+		for (size_t i = 0; i < snapshot.meshes.size(); i++) {
+			const TextureDesc& textures = snapshot.textures[i];
+
+			Protocol::InstanceMessage instance = {};
+			instance.meshHash = snapshot.meshHashes[i];
+			for (int c = 0; c < 4; c++) instance.colour[c] = snapshot.colours[i][c];
+			instance.alphaTest = textures.alphatest ? 1 : 0;
+
+			if (!sendInstance(channel, instance, { snapshot.nodeNames[i], textures.baseColour, textures.normalMap }, timeoutMs)) return false;
+		}
+
+		return sendEndSnapshot(channel, timeoutMs);
+	}
+
+	// Builds MeshData straight from the ring, and the snapshot from meshes it's been sent (this launch or earlier)
+	class SnapshotSink : public SceneSink
+	{
+	public:
+		SnapshotSink(SceneSnapshot& snapshot, std::unordered_map<uint64_t, MeshData::SharedPtr>& receivedMeshes) : snapshot(snapshot), receivedMeshes(receivedMeshes) {}
+
+		bool beginMesh(const Protocol::MeshMessage& message, std::string meshName) override
+		{
+			header = message;
+			name = std::move(meshName);
+			positions.clear();
+			normals.clear();
+			texCoords.clear();
+			packed.clear();
+			blocks.clear();
+			return true;
+		}
+
+		uint8_t* getStream(uint32_t stream) override
+		{
+			switch (stream) {
+			case Protocol::StreamPositions: positions.resize(header.vertexCount); return reinterpret_cast<uint8_t*>(positions.data());
+			case Protocol::StreamNormals: normals.resize(header.vertexCount); return reinterpret_cast<uint8_t*>(normals.data());
+			case Protocol::StreamTexCoords: texCoords.resize(header.vertexCount); return reinterpret_cast<uint8_t*>(texCoords.data());
+			case Protocol::StreamPacked: packed.resize(header.vertexCount); return reinterpret_cast<uint8_t*>(packed.data());
+			case Protocol::StreamBlocks: blocks.resize(getStreamElementCount(header, stream)); return reinterpret_cast<uint8_t*>(blocks.data());
+			default: return nullptr;
+			}
+		}
+
+		bool endMesh() override
+		{
+			// The vectors the chunks were written into become the mesh's, nothing is copied again
+			const bool flipWinding = (header.flags & Protocol::MeshFlipWinding) != 0;
+			if (header.flags & Protocol::MeshQuantised) {
+				receivedMeshes[header.hash] = MeshData::createQuantised(name, std::move(packed), std::move(blocks), flipWinding);
+			} else {
+				receivedMeshes[header.hash] = MeshData::create(name, std::move(positions), std::move(normals), std::move(texCoords), false, flipWinding);
+			}
+			return true;
+		}
+
+		bool onSnapshot(const Protocol::SnapshotMessage& message) override
+		{
+			auto it = receivedMeshes.find(message.worldHash);
+			if (it == receivedMeshes.end()) return false;
+
+			snapshot.world.hash = message.worldHash;
+			snapshot.world.pGeometry = it->second;
+			snapshot.world.sunDirection = float3(message.sunDirection[0], message.sunDirection[1], message.sunDirection[2]);
+			snapshot.cameraPosition = float3(message.cameraPosition[0], message.cameraPosition[1], message.cameraPosition[2]);
+			snapshot.cameraTarget = float3(message.cameraTarget[0], message.cameraTarget[1], message.cameraTarget[2]);
+			return true;
+		}
+
+		bool onInstance(const Protocol::InstanceMessage& message, InstanceStrings strings) override
+		{
+			auto it = receivedMeshes.find(message.meshHash);
+			if (it == receivedMeshes.end()) return false;
+
+			TextureDesc textures;
+			textures.baseColour = std::move(strings.baseTexture);
+			textures.normalMap = std::move(strings.normalMap);
+			textures.alphatest = message.alphaTest != 0;
+
+			snapshot.meshHashes.push_back(message.meshHash);
+			snapshot.meshes.push_back(it->second);
+			snapshot.colours.push_back(float4(message.colour[0], message.colour[1], message.colour[2], message.colour[3]));
+			snapshot.textures.push_back(std::move(textures));
+			snapshot.nodeNames.push_back(std::move(strings.name));
+			return true;
+		}
+
+	private:
+		SceneSnapshot& snapshot;
+		std::unordered_map<uint64_t, MeshData::SharedPtr>& receivedMeshes;
+
+		Protocol::MeshMessage header = {};
+		std::string name;
+		std::vector<float3> positions;
+		std::vector<float3> normals;
+		std::vector<float2> texCoords;
+		std::vector<PackedVertex> packed;
+		std::vector<PackedBlock> blocks;
+	};
+
+	bool receiveSnapshot(SceneChannel& channel, SceneSnapshot& snapshot, std::unordered_map<uint64_t, MeshData::SharedPtr>& receivedMeshes, uint32_t timeoutMs)
+	{
+		snapshot = SceneSnapshot();
+		SnapshotSink sink(snapshot, receivedMeshes);
+		std::string error;
+		if (receiveScene(channel, sink, timeoutMs, error)) return true;
+
+		logError(error);
+		return false;
+	}
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "Renderer.h"
+#include "SceneStream.h"
+#include <unordered_set>
+
+namespace GModDXR
+{
+	// Everything captured by a launch, in the form it's sent to the out of process renderer
+	struct SceneSnapshot
+	{
+		Falcor::float3 cameraPosition;
+		Falcor::float3 cameraTarget;
+		WorldData world;
+
+		// One entry per entity submesh
+		std::vector<uint64_t> meshHashes;
+		std::vector<MeshData::SharedPtr> meshes;
+		std::vector<Falcor::float4> colours;
+		std::vector<TextureDesc> textures;
+		std::vector<std::string> nodeNames;
+	};
+
+	/*
+		Sends a snapshot over the channel (see SceneProtocol.h), after sendHello
+		Meshes whose hashes are in sentMeshes are assumed to already be held by the renderer, and newly sent ones are added
+		Returns false if the renderer stops reading for longer than timeoutMs
+	*/
+	bool sendSnapshot(SceneChannel& channel, const SceneSnapshot& snapshot, std::unordered_set<uint64_t>& sentMeshes, uint32_t timeoutMs);
+
+	/*
+		Reads messages until a full snapshot has been received
+		Meshes are kept in receivedMeshes so later snapshots from the same sender can refer to them
+		Returns false on timeout, shutdown or a malformed message
+	*/
+	bool receiveSnapshot(SceneChannel& channel, SceneSnapshot& snapshot, std::unordered_map<uint64_t, MeshData::SharedPtr>& receivedMeshes, uint32_t timeoutMs);
+}
@@ -0,0 +1,262 @@
+#include "SceneStream.h"
+#include "VertexPacking.h"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace GModDXR
+{
+	template<typename T>
+	static bool writeMessage(SceneChannel& channel, uint32_t type, const T& message, const std::vector<const std::string*>& strings, uint32_t timeoutMs)
+	{
+		uint64_t size = sizeof(T);
+		for (const std::string* pStr : strings) size += pStr->size();
+
+		uint8_t* pPayload = channel.beginWrite(type, size, timeoutMs);
+		if (!pPayload) return false;
+
+		std::memcpy(pPayload, &message, sizeof(T));
+		pPayload += sizeof(T);
+		for (const std::string* pStr : strings) {
+			std::memcpy(pPayload, pStr->data(), pStr->size());
+			pPayload += pStr->size();
+		}
+
+		channel.endWrite();
+		return true;
+	}
+
+	static bool sendStream(SceneChannel& channel, uint64_t hash, uint32_t stream, const void* pData, uint32_t elementCount, uint32_t timeoutMs)
+	{
+		// Streams are copied straight from the mesh into the ring, in chunks small enough to always fit
+		const uint32_t stride = Protocol::getStreamStride(stream);
+		const uint32_t maxChunkElements = static_cast<uint32_t>((channel.getMaxPayloadSize() - sizeof(Protocol::MeshChunkMessage)) / stride);
+
+		for (uint32_t first = 0; first < elementCount;) {
+			const uint32_t count = std::min(maxChunkElements, elementCount - first);
+			const uint64_t bytes = static_cast<uint64_t>(count) * stride;
+
+			uint8_t* pPayload = channel.beginWrite(Protocol::MeshChunk, sizeof(Protocol::MeshChunkMessage) + bytes, timeoutMs);
+			if (!pPayload) return false;
+
+			const Protocol::MeshChunkMessage message = { hash, stream, first, count, 0 };
+			std::memcpy(pPayload, &message, sizeof(message));
+			std::memcpy(pPayload + sizeof(message), static_cast<const uint8_t*>(pData) + static_cast<uint64_t>(first) * stride, bytes);
+			channel.endWrite();
+
+			first += count;
+		}
+
+		return true;
+	}
+
+	bool hasStream(const Protocol::MeshMessage& header, uint32_t stream)
+	{
+		const bool quantised = (header.flags & Protocol::MeshQuantised) != 0;
+		switch (stream) {
+		case Protocol::StreamPositions: return !quantised;
+		case Protocol::StreamNormals: return !quantised;
+		case Protocol::StreamTexCoords: return !quantised && (header.flags & Protocol::MeshHasTexCoords) != 0;
+		case Protocol::StreamPacked: return quantised;
+		case Protocol::StreamBlocks: return quantised;
+		default: return false;
+		}
+	}
+
+	uint32_t getStreamElementCount(const Protocol::MeshMessage& header, uint32_t stream)
+	{
+		if (stream == Protocol::StreamBlocks) return static_cast<uint32_t>(getPackedBlockCount(header.vertexCount));
+		return header.vertexCount;
+	}
+
+	bool sendHello(SceneChannel& channel, uint32_t timeoutMs)
+	{
+		const Protocol::HelloMessage message = { Protocol::kVersion, 0 };
+		return writeMessage(channel, Protocol::Hello, message, {}, timeoutMs);
+	}
+
+	bool sendMesh(SceneChannel& channel, const MeshStreams& mesh, uint32_t timeoutMs)
+	{
+		Protocol::MeshMessage message = mesh.header;
+		message.nameLength = static_cast<uint32_t>(mesh.name.size());
+		if (!writeMessage(channel, Protocol::Mesh, message, { &mesh.name }, timeoutMs)) return false;
+
+		for (uint32_t stream = 0; stream < Protocol::kStreamCount; stream++) {
+			if (hasStream(message, stream) && !sendStream(channel, message.hash, stream, mesh.pStreams[stream], getStreamElementCount(message, stream), timeoutMs)) return false;
+		}
+		return true;
+	}
+
+	bool sendSnapshotHeader(SceneChannel& channel, const Protocol::SnapshotMessage& message, uint32_t timeoutMs)
+	{
+		return writeMessage(channel, Protocol::Snapshot, message, {}, timeoutMs);
+	}
+
+	bool sendInstance(SceneChannel& channel, Protocol::InstanceMessage message, const InstanceStrings& strings, uint32_t timeoutMs)
+	{
+		message.nameLength = static_cast<uint32_t>(strings.name.size());
+		message.baseTextureLength = static_cast<uint32_t>(strings.baseTexture.size());
+		message.normalMapLength = static_cast<uint32_t>(strings.normalMap.size());
+		return writeMessage(channel, Protocol::Instance, message, { &strings.name, &strings.baseTexture, &strings.normalMap }, timeoutMs);
+	}
+
+	bool sendEndSnapshot(SceneChannel& channel, uint32_t timeoutMs)
+	{
+		return channel.write(Protocol::EndSnapshot, nullptr, 0, timeoutMs);
+	}
+
+	// Reads length prefixed strings that follow a message, checking they stay inside the payload
+	class StringReader
+	{
+	public:
+		StringReader(const uint8_t* pData, uint64_t size) : pData(pData), size(size) {}
+
+		bool read(uint32_t length, std::string& out)
+		{
+			if (length > size - offset) return false;
+			out.assign(reinterpret_cast<const char*>(pData + offset), length);
+			offset += length;
+			return true;
+		}
+
+	private:
+		const uint8_t* pData;
+		uint64_t size;
+		uint64_t offset = 0;
+	};
+
+	bool receiveScene(SceneChannel& channel, SceneSink& sink, uint32_t timeoutMs, std::string& error)
+	{
+		// The mesh whose vertex chunks are still arriving
+		bool hasPending = false;
+		Protocol::MeshMessage pending = {};
+		uint8_t* pStreams[Protocol::kStreamCount] = {};
+		uint64_t remainingBytes = 0;
+
+		bool hasSnapshot = false;
+		uint32_t expectedInstances = 0;
+		uint32_t receivedInstances = 0;
+
+		while (true) {
+			const SceneChannel::RecordHeader* pRecord = channel.beginRead(timeoutMs);
+			if (!pRecord) {
+				error = "Scene channel timed out or was closed mid snapshot";
+				return false;
+			}
+
+			const uint32_t type = pRecord->type;
+			const uint8_t* pPayload = reinterpret_cast<const uint8_t*>(pRecord + 1);
+			const uint64_t size = pRecord->size;
+			bool valid = true;
+			bool done = false;
+
+			switch (type) {
+			case Protocol::Hello: {
+				Protocol::HelloMessage message;
+				valid = size >= sizeof(message);
+				if (valid) std::memcpy(&message, pPayload, sizeof(message));
+				if (!valid || message.version != Protocol::kVersion) {
+					channel.endRead();
+					error = "Scene channel protocol version mismatch";
+					return false;
+				}
+				break;
+			}
+			case Protocol::Mesh: {
+				valid = !hasPending && !hasSnapshot && size >= sizeof(Protocol::MeshMessage);
+				if (!valid) break;
+
+				std::memcpy(&pending, pPayload, sizeof(Protocol::MeshMessage));
+				std::string name;
+				StringReader strings(pPayload + sizeof(Protocol::MeshMessage), size - sizeof(Protocol::MeshMessage));
+				valid = strings.read(pending.nameLength, name) && sink.beginMesh(pending, std::move(name));
+				if (!valid) break;
+
+				remainingBytes = 0;
+				for (uint32_t stream = 0; stream < Protocol::kStreamCount; stream++) {
+					pStreams[stream] = hasStream(pending, stream) ? sink.getStream(stream) : nullptr;
+					valid &= !hasStream(pending, stream) || pStreams[stream] || pending.vertexCount == 0; // Empty storage may well be null
+					if (pStreams[stream]) remainingBytes += static_cast<uint64_t>(getStreamElementCount(pending, stream)) * Protocol::getStreamStride(stream);
+				}
+				hasPending = true;
+				break;
+			}
+			case Protocol::MeshChunk: {
+				Protocol::MeshChunkMessage message;
+				valid = hasPending && size >= sizeof(message);
+				if (!valid) break;
+				std::memcpy(&message, pPayload, sizeof(message));
+				valid = message.hash == pending.hash && message.stream < Protocol::kStreamCount && pStreams[message.stream];
+				if (!valid) break;
+
+				// The only copy on the receiving side, out of the ring (whose space is about to be reused) into the sink's storage
+				const uint32_t stride = Protocol::getStreamStride(message.stream);
+				const uint64_t bytes = static_cast<uint64_t>(message.elementCount) * stride;
+				valid =
+					static_cast<uint64_t>(message.firstElement) + message.elementCount <= getStreamElementCount(pending, message.stream) &&
+					size - sizeof(message) >= bytes && bytes <= remainingBytes;
+				if (!valid) break;
+
+				std::memcpy(pStreams[message.stream] + static_cast<uint64_t>(message.firstElement) * stride, pPayload + sizeof(message), bytes);
+				remainingBytes -= bytes;
+				break;
+			}
+			case Protocol::Snapshot: {
+				Protocol::SnapshotMessage message;
+				valid = !hasPending && !hasSnapshot && size >= sizeof(message);
+				if (!valid) break;
+				std::memcpy(&message, pPayload, sizeof(message));
+
+				valid = sink.onSnapshot(message);
+				expectedInstances = message.instanceCount;
+				hasSnapshot = true;
+				break;
+			}
+			case Protocol::Instance: {
+				Protocol::InstanceMessage message;
+				valid = hasSnapshot && receivedInstances < expectedInstances && size >= sizeof(message);
+				if (!valid) break;
+				std::memcpy(&message, pPayload, sizeof(message));
+
+				InstanceStrings instanceStrings;
+				StringReader strings(pPayload + sizeof(message), size - sizeof(message));
+				valid =
+					strings.read(message.nameLength, instanceStrings.name) &&
+					strings.read(message.baseTextureLength, instanceStrings.baseTexture) &&
+					strings.read(message.normalMapLength, instanceStrings.normalMap) &&
+					sink.onInstance(message, std::move(instanceStrings));
+				receivedInstances++;
+				break;
+			}
+			case Protocol::EndSnapshot:
+				valid = hasSnapshot && receivedInstances == expectedInstances;
+				done = true;
+				break;
+			case Protocol::Shutdown:
+				channel.endRead();
+				error = "Scene channel was shut down mid snapshot";
+				return false;
+			default:
+				channel.endRead();
+				error = "Unknown scene channel message type " + std::to_string(type);
+				return false;
+			}
+
+			channel.endRead(); // The record can be overwritten from here on
+			if (!valid) {
+				error = "Malformed scene channel message (type " + std::to_string(type) + ")";
+				return false;
+			}
+
+			if (hasPending && remainingBytes == 0) {
+				hasPending = false;
+				if (!sink.endMesh()) {
+					error = "Scene channel mesh was rejected";
+					return false;
+				}
+			}
+
+			if (done) return true;
+		}
+	}
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "SceneChannel.h"
+#include "SceneProtocol.h"
+#include <string>
+
+namespace GModDXR
+{
+	/*
+		Writes and reads the scene protocol's messages (see SceneProtocol.h), without knowing how meshes are stored
+		SceneSnapshot.cpp adapts it to MeshData, and it doesn't depend on Falcor so a real round trip can be checked on its own (see Tools/SceneStreamTest.cpp)
+
+		Each side copies vertex data once: the sender from the mesh's storage into the ring, the receiver from the ring into the storage
+		its SceneSink hands out, which becomes the received mesh (there are no staging buffers on either side)
+	*/
+
+	// A mesh's vertex streams, in memory owned by the caller
+	struct MeshStreams
+	{
+		Protocol::MeshMessage header = {}; // nameLength is filled in when sent
+		std::string name;
+		const void* pStreams[Protocol::kStreamCount] = {}; // Indexed by Protocol::VertexStream, only the streams header.flags call for are sent
+	};
+
+	struct InstanceStrings
+	{
+		std::string name;
+		std::string baseTexture;
+		std::string normalMap;
+	};
+
+	bool sendHello(SceneChannel& channel, uint32_t timeoutMs);
+	bool sendMesh(SceneChannel& channel, const MeshStreams& mesh, uint32_t timeoutMs);
+	bool sendSnapshotHeader(SceneChannel& channel, const Protocol::SnapshotMessage& message, uint32_t timeoutMs);
+	bool sendInstance(SceneChannel& channel, Protocol::InstanceMessage message, const InstanceStrings& strings, uint32_t timeoutMs);
+	bool sendEndSnapshot(SceneChannel& channel, uint32_t timeoutMs);
+
+	// Streams a mesh with this header carries
+	bool hasStream(const Protocol::MeshMessage& header, uint32_t stream);
+	// Elements (vertices, or blocks of them) in a stream of a mesh with this header
+	uint32_t getStreamElementCount(const Protocol::MeshMessage& header, uint32_t stream);
+
+	/*
+		Receives the messages of a snapshot, the framing and validation is done by receiveScene and storage is left to the sink
+		Any callback returning false (or nullptr) rejects the snapshot
+	*/
+	class SceneSink
+	{
+	public:
+		virtual ~SceneSink() = default;
+
+		// Starts a mesh, whose vertices then arrive in chunks
+		virtual bool beginMesh(const Protocol::MeshMessage& header, std::string name) = 0;
+		// Where the pending mesh's stream (of getStreamElementCount elements) is written, called once per stream the header calls for
+		virtual uint8_t* getStream(uint32_t stream) = 0;
+		// Every byte of the pending mesh has arrived
+		virtual bool endMesh() = 0;
+
+		virtual bool onSnapshot(const Protocol::SnapshotMessage& message) = 0;
+		virtual bool onInstance(const Protocol::InstanceMessage& message, InstanceStrings strings) = 0;
+	};
+
+	/*
+		Reads messages until a full snapshot has been received
+		Returns false (with the reason in error) on timeout, shutdown or a malformed message, including one the sink rejects
+	*/
+	bool receiveScene(SceneChannel& channel, SceneSink& sink, uint32_t timeoutMs, std::string& error);
+}
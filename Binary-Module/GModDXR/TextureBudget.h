@@ -0,0 +1,107 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace GModDXR
+{
+	// Budget state of a streamed texture, TextureStreamer's entries derive from it
+	struct TextureBudgetEntry
+	{
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint32_t bytesPerPixel = 4;
+		uint32_t startMip = 0;
+
+		uint32_t residentMip = UINT32_MAX; // UINT32_MAX until the start mip is loaded
+		uint32_t desiredMip = UINT32_MAX;
+		uint32_t targetMip = UINT32_MAX;
+		uint64_t lastRequestFrame = 0;
+	};
+
+	/*
+		Texture streaming policy, kept apart from TextureStreamer (and Falcor) so it can be checked on its own (see Tools/StreamingTest.cpp)
+	*/
+	inline uint64_t mipChainBytes(uint32_t width, uint32_t height, uint32_t bytesPerPixel, uint32_t firstMip)
+	{
+		uint64_t bytes = 0;
+		for (uint32_t mip = firstMip; mip < 32U; mip++) {
+			const uint64_t w = std::max(width >> mip, 1U);
+			const uint64_t h = std::max(height >> mip, 1U);
+			bytes += w * h * bytesPerPixel;
+			if (w == 1 && h == 1) break;
+		}
+		return bytes;
+	}
+
+	/** Updates each texture's desired mip from this frame's feedback.
+		\param[in] requested Finest mip requested per texture this frame, UINT32_MAX if it wasn't seen.
+		Textures that go unrequested for more than evictAfterFrames fall back to their start mip.
+	*/
+	template<typename Entry>
+	void applyMipRequests(std::vector<Entry>& entries, const std::vector<uint32_t>& requested, uint64_t frame, uint64_t evictAfterFrames)
+	{
+		for (size_t i = 0; i < entries.size(); i++) {
+			TextureBudgetEntry& e = entries[i];
+			if (requested[i] != UINT32_MAX) {
+				e.desiredMip = std::min(requested[i], e.startMip);
+				e.lastRequestFrame = frame;
+			} else if (frame - e.lastRequestFrame > evictAfterFrames) {
+				e.desiredMip = e.startMip;
+			}
+		}
+	}
+
+	/** Sets each resident texture's target mip to its desired mip, then takes the least recently requested textures down
+		towards their start mips until the targets fit the budget, only moving on to more recently requested ones when that isn't enough.
+		Equally recent textures give up a mip at a time (largest first), so none of them is emptied for the others.
+		Start mips are never evicted, so a budget smaller than the start set is simply exceeded.
+		\return Bytes of the target mip chains.
+	*/
+	template<typename Entry>
+	uint64_t fitTexturesToBudget(std::vector<Entry>& entries, uint64_t budgetBytes)
+	{
+		uint64_t total = 0;
+		std::vector<size_t> order;
+		for (size_t i = 0; i < entries.size(); i++) {
+			TextureBudgetEntry& e = entries[i];
+			if (e.residentMip == UINT32_MAX) continue;
+			e.targetMip = std::min(e.desiredMip, e.startMip);
+			total += mipChainBytes(e.width, e.height, e.bytesPerPixel, e.targetMip);
+			order.push_back(i);
+		}
+		if (total <= budgetBytes) return total;
+
+		std::sort(order.begin(), order.end(), [&entries](size_t a, size_t b) {
+			const TextureBudgetEntry& ea = entries[a];
+			const TextureBudgetEntry& eb = entries[b];
+			if (ea.lastRequestFrame != eb.lastRequestFrame) return ea.lastRequestFrame < eb.lastRequestFrame;
+			return mipChainBytes(ea.width, ea.height, ea.bytesPerPixel, ea.targetMip) > mipChainBytes(eb.width, eb.height, eb.bytesPerPixel, eb.targetMip);
+		});
+
+		for (size_t begin = 0; begin < order.size() && total > budgetBytes;) {
+			const uint64_t frame = entries[order[begin]].lastRequestFrame;
+			size_t end = begin;
+			while (end < order.size() && entries[order[end]].lastRequestFrame == frame) end++;
+
+			bool progress = true;
+			while (total > budgetBytes && progress) {
+				progress = false;
+				for (size_t j = begin; j < end; j++) {
+					TextureBudgetEntry& e = entries[order[j]];
+					if (e.targetMip >= e.startMip) continue;
+
+					total -= mipChainBytes(e.width, e.height, e.bytesPerPixel, e.targetMip);
+					e.targetMip++;
+					total += mipChainBytes(e.width, e.height, e.bytesPerPixel, e.targetMip);
+					progress = true;
+
+					if (total <= budgetBytes) break;
+				}
+			}
+			begin = end;
+		}
+		return total;
+	}
+}
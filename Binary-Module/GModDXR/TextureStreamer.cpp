@@ -0,0 +1,356 @@
+#include "TextureStreamer.h"
+#include <filesystem>
+
+namespace GModDXR
+{
+	using namespace Falcor;
+
+	HashCache<TextureStreamer::LoadResult> TextureStreamer::decodeCache;
+	LruCache<TextureStreamer::DecodedImage> TextureStreamer::decodedImages(TextureStreamer::kDecodedCacheBytes);
+
+	TextureStreamer::SharedPtr TextureStreamer::create(uint64_t budgetBytes)
+	{
+		return SharedPtr(new TextureStreamer(budgetBytes));
+	}
+
+	void TextureStreamer::addMaterial(const Material::SharedPtr& pMaterial, const TriangleMesh::SharedPtr& pMesh)
+	{
+		// Average texture space area per world space area, used to turn a pixel footprint into texels
+		float worldArea = 0.f;
+		float uvArea = 0.f;
+		const auto& vertices = pMesh->getVertices();
+		const auto& indices = pMesh->getIndices();
+		for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+			const TriangleMesh::Vertex& a = vertices[indices[i]];
+			const TriangleMesh::Vertex& b = vertices[indices[i + 1]];
+			const TriangleMesh::Vertex& c = vertices[indices[i + 2]];
+
+			worldArea += glm::length(glm::cross(b.position - a.position, c.position - a.position));
+
+			const float2 e0 = b.texCoord - a.texCoord;
+			const float2 e1 = c.texCoord - a.texCoord;
+			uvArea += std::abs(e0.x * e1.y - e0.y * e1.x);
+		}
+
+		MaterialRecord record;
+		record.pMaterial = pMaterial;
+		record.uvPerWorldUnit = worldArea > 0.f && uvArea > 0.f ? std::sqrt(uvArea / worldArea) : 1.f;
+
+		materialLookup[pMaterial.get()] = materials.size();
+		materials.push_back(record);
+	}
+
+	bool TextureStreamer::addTexture(const Material::SharedPtr& pMaterial, Material::TextureSlot slot, const std::string& filename, bool srgb)
+	{
+		std::string fullPath;
+		if (!findFileInDataDirectories(filename, fullPath)) return false;
+
+		auto material = materialLookup.find(pMaterial.get());
+		if (material == materialLookup.end()) {
+			logError("Attempted to stream a texture for an unregistered material");
+			return false;
+		}
+
+		// Textures are shared between every material and slot that uses the same file
+		const std::string key = fullPath + (srgb ? "|srgb" : "");
+		auto existing = entryLookup.find(key);
+		size_t index;
+		if (existing == entryLookup.end()) {
+			index = entries.size();
+			entryLookup[key] = index;
+
+			TextureEntry entry;
+			entry.fullPath = fullPath;
+			entry.srgb = srgb;
+			entries.push_back(entry);
+		} else {
+			index = existing->second;
+		}
+
+		entries[index].users.emplace_back(pMaterial, slot);
+		materials[material->second].textures.push_back(index);
+		return true;
+	}
+
+	void TextureStreamer::loadInitial()
+	{
+		PROFILE("TextureStreamer::loadInitial");
+
+		// Reuse start mips decoded last launch for files that haven't changed
+		decodeCache.beginLaunch();
+		std::vector<LoadResult> results(entries.size());
+		std::vector<uint64_t> hashes(entries.size());
+		std::vector<size_t> toDecode;
+		for (size_t i = 0; i < entries.size(); i++) {
+			hashes[i] = entries[i].fileHash = hashFile(entries[i].fullPath);
+			if (decodeCache.find(hashes[i], results[i])) {
+				results[i].entry = i;
+			} else {
+				toDecode.push_back(i);
+			}
+		}
+
+		// Decode the rest in parallel, but create the textures on this thread
+		std::atomic<size_t> next = 0;
+		std::vector<std::thread> workers;
+		for (uint32_t i = 0; i < std::max(1u, std::thread::hardware_concurrency()); i++) {
+			workers.emplace_back([&]() {
+				for (size_t j = next++; j < toDecode.size(); j = next++) results[toDecode[j]] = loadMip(toDecode[j], entries[toDecode[j]].fullPath, hashes[toDecode[j]], kStartDim, false);
+			});
+		}
+		for (auto& worker : workers) worker.join();
+
+		for (size_t i : toDecode) {
+			if (results[i].success) decodeCache.insert(hashes[i], results[i]);
+		}
+
+		for (auto& result : results) applyLoad(result);
+		logInfo(
+			"Streaming " + std::to_string(entries.size()) + " textures, " + std::to_string(getResidentBytes() / (1024 * 1024)) + "MB resident at start (" +
+			std::to_string(static_cast<int>(decodeCache.getReusePercent())) + "% reused from the last launch)"
+		);
+	}
+
+	void TextureStreamer::setScene(const Scene::SharedPtr& pScene)
+	{
+		const uint32_t materialCount = pScene->getMaterialCount();
+		sceneMaterials.assign(materialCount, SIZE_MAX);
+		for (uint32_t id = 0; id < materialCount; id++) {
+			auto record = materialLookup.find(pScene->getMaterial(id).get());
+			if (record != materialLookup.end()) sceneMaterials[id] = record->second;
+		}
+
+		// Feedback holds the smallest pixel footprint per material as float bits, cleared to UINT32_MAX (no hits)
+		const uint32_t elementCount = std::max(materialCount, 1u);
+		std::vector<uint32_t> cleared(elementCount, UINT32_MAX);
+		pFeedback = Buffer::createStructured(sizeof(uint32_t), elementCount, ResourceBindFlags::ShaderResource | ResourceBindFlags::UnorderedAccess, Buffer::CpuAccess::None, cleared.data(), false);
+		for (auto& pBuffer : pReadback) pBuffer = Buffer::create(elementCount * sizeof(uint32_t), ResourceBindFlags::None, Buffer::CpuAccess::Read);
+	}
+
+	void TextureStreamer::setShaderData(const ShaderVar& var) const
+	{
+		var["gTextureFeedback"] = pFeedback;
+	}
+
+	void TextureStreamer::update(RenderContext* pContext)
+	{
+		PROFILE("TextureStreamer::update");
+		frame++;
+		swappedMaterials.clear();
+
+		// The readback buffer about to be reused holds the oldest feedback, so read it before copying over it
+		if (pFeedback) {
+			const Buffer::SharedPtr& pCurrent = pReadback[frame % kFeedbackLatency];
+			if (frame > kFeedbackLatency) {
+				readFeedback(static_cast<const uint32_t*>(pCurrent->map(Buffer::MapType::Read)));
+				pCurrent->unmap();
+			}
+
+			pContext->copyResource(pCurrent.get(), pFeedback.get());
+			pContext->clearUAV(pFeedback->getUAV().get(), uint4(UINT32_MAX));
+		}
+
+		// Swap in finished loads
+		for (auto it = loads.begin(); it != loads.end();) {
+			if (it->wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+				LoadResult result = it->get();
+				applyLoad(result);
+				it = loads.erase(it);
+			} else {
+				it++;
+			}
+		}
+
+		fitToBudget();
+
+		// Queue loads for textures not at their target, downgrades first so upgrades don't push us further over budget
+		std::vector<size_t> candidates;
+		for (size_t i = 0; i < entries.size(); i++) {
+			const TextureEntry& e = entries[i];
+			if (!e.pending && e.residentMip != UINT32_MAX && e.targetMip != e.residentMip) candidates.push_back(i);
+		}
+		std::sort(candidates.begin(), candidates.end(), [this](size_t a, size_t b) {
+			const TextureEntry& ea = entries[a];
+			const TextureEntry& eb = entries[b];
+			const bool downA = ea.targetMip > ea.residentMip;
+			const bool downB = eb.targetMip > eb.residentMip;
+			if (downA != downB) return downA;
+			return std::abs(static_cast<int>(ea.targetMip) - static_cast<int>(ea.residentMip)) > std::abs(static_cast<int>(eb.targetMip) - static_cast<int>(eb.residentMip));
+		});
+
+		for (size_t i : candidates) {
+			if (loads.size() >= kMaxLoadsInFlight) break;
+
+			TextureEntry& e = entries[i];
+			e.pending = true;
+			const uint32_t maxDim = std::max(std::max(e.width, e.height) >> e.targetMip, 1u);
+			loads.push_back(std::async(std::launch::async, loadMip, i, e.fullPath, e.fileHash, maxDim, true));
+		}
+	}
+
+	void TextureStreamer::readFeedback(const uint32_t* pFootprints)
+	{
+		std::vector<uint32_t> requested(entries.size(), UINT32_MAX);
+		for (size_t id = 0; id < sceneMaterials.size(); id++) {
+			if (sceneMaterials[id] == SIZE_MAX || pFootprints[id] == UINT32_MAX) continue;
+
+			float footprint;
+			std::memcpy(&footprint, &pFootprints[id], sizeof(float));
+
+			// A pixel covering n texels wants the mip where it covers one
+			const MaterialRecord& material = materials[sceneMaterials[id]];
+			for (size_t index : material.textures) {
+				const TextureEntry& e = entries[index];
+				const float texels = footprint * material.uvPerWorldUnit * static_cast<float>(std::max(e.width, e.height));
+				const uint32_t mip = texels > 1.f ? static_cast<uint32_t>(std::log2(texels)) : 0U;
+				requested[index] = std::min(requested[index], mip);
+			}
+		}
+
+		applyMipRequests(entries, requested, frame, kEvictAfterFrames);
+	}
+
+	void TextureStreamer::fitToBudget()
+	{
+		fitTexturesToBudget(entries, budgetBytes);
+	}
+
+	void TextureStreamer::applyLoad(LoadResult& result)
+	{
+		TextureEntry& e = entries[result.entry];
+		e.pending = false;
+		if (!result.success) {
+			logWarning("Failed to stream texture " + e.fullPath);
+			return;
+		}
+
+		e.width = result.width;
+		e.height = result.height;
+		e.bytesPerPixel = getFormatBytesPerBlock(result.format);
+		e.mipCount = result.mipCount;
+		if (e.residentMip == UINT32_MAX) e.startMip = e.desiredMip = e.targetMip = result.mip;
+
+		const uint32_t width = std::max(e.width >> result.mip, 1u);
+		const uint32_t height = std::max(e.height >> result.mip, 1u);
+		const ResourceFormat format = e.srgb ? linearToSrgbFormat(result.format) : result.format;
+		Texture::SharedPtr pTexture = Texture::create2D(width, height, format, 1, Texture::kMaxPossible, result.data.data(), ResourceBindFlags::ShaderResource | ResourceBindFlags::RenderTarget);
+		if (!pTexture) {
+			logWarning("Failed to create texture for " + e.fullPath);
+			return;
+		}
+		pTexture->setSourceFilename(e.fullPath);
+
+		for (auto& [pMaterial, slot] : e.users) {
+			pMaterial->setTexture(slot, pTexture);
+			if (e.residentMip != UINT32_MAX) swappedMaterials.insert(pMaterial.get());
+		}
+		e.residentMip = result.mip;
+	}
+
+	TextureStreamer::LoadResult TextureStreamer::loadMip(size_t entry, const std::string& fullPath, uint64_t fileHash, uint32_t maxDim, bool cacheDecoded)
+	{
+		LoadResult result;
+		result.entry = entry;
+
+		// Streaming moves a texture between mips of the same image, so the decoded file is kept rather than decoded for every step
+		std::shared_ptr<const DecodedImage> pImage = decodedImages.find(fileHash);
+		if (!pImage) {
+			Bitmap::UniqueConstPtr pBitmap = Bitmap::createFromFile(fullPath, true);
+			if (!pBitmap) return result;
+
+			auto pDecoded = std::make_shared<DecodedImage>();
+			pDecoded->format = pBitmap->getFormat();
+			pDecoded->width = pBitmap->getWidth();
+			pDecoded->height = pBitmap->getHeight();
+			const uint8_t* pData = pBitmap->getData();
+			pDecoded->data.assign(pData, pData + static_cast<size_t>(pDecoded->width) * pDecoded->height * getFormatBytesPerBlock(pDecoded->format));
+
+			if (cacheDecoded) decodedImages.insert(fileHash, pDecoded, pDecoded->data.size());
+			pImage = pDecoded;
+		}
+
+		result.format = pImage->format;
+		result.width = pImage->width;
+		result.height = pImage->height;
+
+		const uint32_t bytesPerPixel = getFormatBytesPerBlock(result.format);
+		result.data = pImage->data;
+
+		// Only 8 bit per channel formats are box filtered down, anything else stays at full resolution
+		const bool streamable = bytesPerPixel == getFormatChannelCount(result.format);
+		result.mipCount = streamable ? 1U + static_cast<uint32_t>(std::log2(std::max(result.width, result.height))) : 1U;
+
+		uint32_t width = result.width;
+		uint32_t height = result.height;
+		while (streamable && std::max(width, height) > maxDim) {
+			const uint32_t nextWidth = std::max(width / 2U, 1U);
+			const uint32_t nextHeight = std::max(height / 2U, 1U);
+			std::vector<uint8_t> next(static_cast<size_t>(nextWidth) * nextHeight * bytesPerPixel);
+
+			for (uint32_t y = 0; y < nextHeight; y++) {
+				const size_t row0 = static_cast<size_t>(std::min(y * 2U, height - 1U)) * width;
+				const size_t row1 = static_cast<size_t>(std::min(y * 2U + 1U, height - 1U)) * width;
+				for (uint32_t x = 0; x < nextWidth; x++) {
+					const size_t col0 = std::min(x * 2U, width - 1U);
+					const size_t col1 = std::min(x * 2U + 1U, width - 1U);
+					for (uint32_t c = 0; c < bytesPerPixel; c++) {
+						const uint32_t sum =
+							result.data[(row0 + col0) * bytesPerPixel + c] + result.data[(row0 + col1) * bytesPerPixel + c] +
+							result.data[(row1 + col0) * bytesPerPixel + c] + result.data[(row1 + col1) * bytesPerPixel + c];
+						next[(static_cast<size_t>(y) * nextWidth + x) * bytesPerPixel + c] = static_cast<uint8_t>((sum + 2U) / 4U);
+					}
+				}
+			}
+
+			result.data.swap(next);
+			width = nextWidth;
+			height = nextHeight;
+			result.mip++;
+		}
+
+		result.success = true;
+		return result;
+	}
+
+	uint64_t TextureStreamer::hashFile(const std::string& fullPath)
+	{
+		std::error_code err;
+		const uintmax_t size = std::filesystem::file_size(fullPath, err);
+		const auto modified = std::filesystem::last_write_time(fullPath, err).time_since_epoch().count();
+
+		uint64_t hash = hashString(fullPath);
+		hash = hashValue(size, hash);
+		return hashValue(modified, hash);
+	}
+
+	uint64_t TextureStreamer::getResidentBytes() const
+	{
+		uint64_t bytes = 0;
+		for (const TextureEntry& e : entries) {
+			if (e.residentMip != UINT32_MAX) bytes += mipChainBytes(e.width, e.height, e.bytesPerPixel, e.residentMip);
+		}
+		return bytes;
+	}
+
+	uint64_t TextureStreamer::getCachedBytes()
+	{
+		uint64_t bytes = 0;
+		decodeCache.forEach([&bytes](const LoadResult& result) { bytes += result.data.size(); });
+		return bytes + decodedImages.getBytes();
+	}
+
+	void TextureStreamer::renderUI(Gui::Widgets& widget)
+	{
+		float budgetMb = static_cast<float>(budgetBytes) / (1024.f * 1024.f);
+		if (widget.var("Budget (MB)", budgetMb, 64.f, 65536.f, 64.f, false, "%.0f")) budgetBytes = static_cast<uint64_t>(budgetMb) * 1024 * 1024;
+
+		size_t atFullRes = 0;
+		for (const TextureEntry& e : entries) {
+			if (e.residentMip == 0) atFullRes++;
+		}
+
+		widget.text("Resident: " + std::to_string(getResidentBytes() / (1024 * 1024)) + "MB");
+		widget.text("Textures: " + std::to_string(entries.size()) + " (" + std::to_string(atFullRes) + " at full resolution)");
+		widget.text("Loads in flight: " + std::to_string(loads.size()));
+	}
+}
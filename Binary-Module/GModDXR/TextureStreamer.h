@@ -0,0 +1,121 @@
+#pragma once
+
+#include "Falcor.h"
+#include "SceneCache.h"
+#include "TextureBudget.h"
+#include <future>
+#include <unordered_set>
+
+namespace GModDXR
+{
+	/*
+		Keeps material textures resident at the mip level the path tracer needs while staying under a memory budget
+
+		Every texture starts at a low mip and is upgraded or downgraded by background loads, using feedback
+		written by the primary hit shader (the smallest world space pixel footprint seen per material)
+	*/
+	class TextureStreamer
+	{
+	public:
+		using SharedPtr = std::shared_ptr<TextureStreamer>;
+
+		static SharedPtr create(uint64_t budgetBytes);
+
+		// Registers a material and estimates its texel density from the mesh it's applied to
+		void addMaterial(const Falcor::Material::SharedPtr& pMaterial, const Falcor::TriangleMesh::SharedPtr& pMesh);
+
+		// Adds a texture to a registered material, returns false if the file couldn't be found
+		bool addTexture(const Falcor::Material::SharedPtr& pMaterial, Falcor::Material::TextureSlot slot, const std::string& filename, bool srgb);
+
+		// Loads every texture at its starting mip, must be called before building the scene
+		void loadInitial();
+
+		// Maps scene material IDs to registered materials and creates the feedback buffers
+		void setScene(const Falcor::Scene::SharedPtr& pScene);
+
+		void setShaderData(const Falcor::ShaderVar& var) const;
+		void update(Falcor::RenderContext* pContext);
+		void renderUI(Falcor::Gui::Widgets& widget);
+
+		uint64_t getBudget() const { return budgetBytes; }
+		void setBudget(uint64_t bytes) { budgetBytes = bytes; }
+		uint64_t getResidentBytes() const;
+		static uint64_t getCachedBytes(); // CPU memory held by the decoded start mip and full resolution caches
+		// Materials the last update swapped a texture of to another mip (which flags them, and the scene's materials, as changed)
+		const std::unordered_set<const Falcor::Material*>& getSwappedMaterials() const { return swappedMaterials; }
+
+	private:
+		TextureStreamer(uint64_t budgetBytes) : budgetBytes(budgetBytes) {}
+
+		static const uint32_t kStartDim = 128;           // Textures are first loaded at the largest mip no bigger than this
+		static const uint32_t kFeedbackLatency = 3;      // Frames between writing feedback and reading it back
+		static const uint32_t kEvictAfterFrames = 120;   // Frames without a request before a texture falls back to its start mip
+		static const uint32_t kMaxLoadsInFlight = 4;
+		static const uint64_t kDecodedCacheBytes = 512ULL * 1024 * 1024; // Full resolution images kept so mip changes don't decode the file again
+
+		struct TextureEntry : TextureBudgetEntry
+		{
+			std::string fullPath;
+			uint64_t fileHash = 0;
+			bool srgb = false;
+			std::vector<std::pair<Falcor::Material::SharedPtr, Falcor::Material::TextureSlot>> users;
+
+			uint32_t mipCount = 1;
+			bool pending = false;
+		};
+
+		struct MaterialRecord
+		{
+			Falcor::Material::SharedPtr pMaterial;
+			float uvPerWorldUnit = 1.f;
+			std::vector<size_t> textures;
+		};
+
+		struct LoadResult
+		{
+			size_t entry;
+			bool success = false;
+			uint32_t width = 0;
+			uint32_t height = 0;
+			uint32_t mip = 0;
+			uint32_t mipCount = 1;
+			Falcor::ResourceFormat format = Falcor::ResourceFormat::Unknown;
+			std::vector<uint8_t> data;
+		};
+
+		struct DecodedImage
+		{
+			uint32_t width = 0;
+			uint32_t height = 0;
+			Falcor::ResourceFormat format = Falcor::ResourceFormat::Unknown;
+			std::vector<uint8_t> data;
+		};
+
+		uint64_t budgetBytes;
+		uint64_t frame = 0;
+		std::unordered_set<const Falcor::Material*> swappedMaterials;
+
+		std::vector<TextureEntry> entries;
+		std::unordered_map<std::string, size_t> entryLookup;
+		std::vector<MaterialRecord> materials;
+		std::unordered_map<const Falcor::Material*, size_t> materialLookup;
+		std::vector<size_t> sceneMaterials; // Scene material ID to index in materials (SIZE_MAX if not streamed)
+
+		Falcor::Buffer::SharedPtr pFeedback;
+		std::array<Falcor::Buffer::SharedPtr, kFeedbackLatency> pReadback;
+
+		std::vector<std::future<LoadResult>> loads;
+
+		// Start mips decoded in the last launch, keyed by path and file size/modification time
+		static HashCache<LoadResult> decodeCache;
+		static LruCache<DecodedImage> decodedImages;
+		static uint64_t hashFile(const std::string& fullPath);
+
+		// Loads the largest mip no bigger than maxDim, cacheDecoded keeps the full resolution image for later mip changes
+		static LoadResult loadMip(size_t entry, const std::string& fullPath, uint64_t fileHash, uint32_t maxDim, bool cacheDecoded);
+
+		void applyLoad(LoadResult& result);
+		void readFeedback(const uint32_t* pFootprints);
+		void fitToBudget();
+	};
+}
@@ -0,0 +1,167 @@
+/*
+	Two process benchmark for SceneChannel and the scene protocol, with a stub consumer in place of the renderer
+
+	Built with the tests (Tools/CMakeLists.txt) but not run by ctest, run the consumer and producer as separate processes:
+		./ChannelBench consume bench & ./ChannelBench produce bench [meshes] [vertices per mesh] [snapshots]
+
+	The producer sends synthetic snapshots with the module's send code (every mesh in the first, only instances after),
+	and the consumer validates them and reports throughput and per record latency
+	Tools/SceneStreamTest.cpp checks the receiving side's code, this only measures the transport
+*/
+#include "SceneStream.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace GModDXR;
+
+static const uint64_t kCapacity = 64ULL * 1024 * 1024;
+static const uint32_t kTimeoutMs = 10000;
+
+// Deterministic vertex bytes, so the consumer can check what arrived without the producer sending a copy
+static uint8_t patternByte(uint64_t hash, uint64_t offset)
+{
+	return static_cast<uint8_t>((hash * 31 + offset * 2654435761ULL) >> 13);
+}
+
+static int produce(const std::string& name, uint32_t meshCount, uint32_t vertexCount, uint32_t snapshotCount)
+{
+	SceneChannel::UniquePtr pChannel = SceneChannel::create(name, kCapacity);
+	if (!pChannel) {
+		std::fprintf(stderr, "Failed to create channel %s\n", name.c_str());
+		return 1;
+	}
+	if (!pChannel->waitForConsumer(kTimeoutMs)) {
+		std::fprintf(stderr, "No consumer attached\n");
+		return 1;
+	}
+
+	if (!sendHello(*pChannel, kTimeoutMs)) return 1;
+
+	std::vector<uint8_t> vertices(static_cast<size_t>(vertexCount) * Protocol::getStreamStride(Protocol::StreamPacked));
+	std::vector<uint8_t> blocks;
+
+	for (uint32_t snapshot = 0; snapshot < snapshotCount; snapshot++) {
+		// Meshes are only sent with the first snapshot, later ones refer to them by hash
+		for (uint32_t mesh = 0; mesh < meshCount && snapshot == 0; mesh++) {
+			MeshStreams streams;
+			streams.header.hash = mesh + 1;
+			streams.header.vertexCount = vertexCount;
+			streams.header.flags = Protocol::MeshQuantised;
+			streams.pStreams[Protocol::StreamPacked] = vertices.data();
+			for (size_t i = 0; i < vertices.size(); i++) vertices[i] = patternByte(streams.header.hash, i);
+			blocks.resize(static_cast<size_t>(getStreamElementCount(streams.header, Protocol::StreamBlocks)) * Protocol::getStreamStride(Protocol::StreamBlocks));
+			streams.pStreams[Protocol::StreamBlocks] = blocks.data();
+			for (size_t i = 0; i < blocks.size(); i++) blocks[i] = patternByte(streams.header.hash, i);
+
+			if (!sendMesh(*pChannel, streams, kTimeoutMs)) return 1;
+		}
+
+		Protocol::SnapshotMessage message = {};
+		message.worldHash = 1;
+		message.instanceCount = meshCount;
+		if (!sendSnapshotHeader(*pChannel, message, kTimeoutMs)) return 1;
+
+		for (uint32_t mesh = 0; mesh < meshCount; mesh++) {
+			Protocol::InstanceMessage instance = {};
+			instance.meshHash = mesh + 1;
+			if (!sendInstance(*pChannel, instance, {}, kTimeoutMs)) return 1;
+		}
+
+		if (!sendEndSnapshot(*pChannel, kTimeoutMs)) return 1;
+	}
+
+	pChannel->write(Protocol::Shutdown, nullptr, 0, kTimeoutMs);
+
+	// Keep the shared memory alive until the consumer's done with it
+	while (!pChannel->isClosed()) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	return 0;
+}
+
+static int consume(const std::string& name)
+{
+	SceneChannel::UniquePtr pChannel;
+	for (uint32_t attempt = 0; attempt < 1000 && !pChannel; attempt++) {
+		pChannel = SceneChannel::open(name);
+		if (!pChannel) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	if (!pChannel) {
+		std::fprintf(stderr, "Failed to open channel %s\n", name.c_str());
+		return 1;
+	}
+
+	std::vector<uint64_t> latencies;
+	uint64_t bytes = 0, vertices = 0, instances = 0, snapshots = 0, mismatches = 0;
+	uint64_t start = 0;
+	bool running = true;
+
+	while (running) {
+		const SceneChannel::RecordHeader* pRecord = pChannel->beginRead(kTimeoutMs);
+		if (!pRecord) {
+			std::fprintf(stderr, "Timed out waiting for the producer\n");
+			return 1;
+		}
+
+		const uint64_t received = SceneChannel::now();
+		if (start == 0) start = pRecord->sendTimeNs;
+		latencies.push_back(received - pRecord->sendTimeNs);
+		bytes += sizeof(SceneChannel::RecordHeader) + pRecord->size;
+
+		const uint8_t* pPayload = reinterpret_cast<const uint8_t*>(pRecord + 1);
+		switch (pRecord->type) {
+		case Protocol::MeshChunk: {
+			Protocol::MeshChunkMessage chunk;
+			std::memcpy(&chunk, pPayload, sizeof(chunk));
+			const uint32_t stride = Protocol::getStreamStride(chunk.stream);
+			const uint64_t chunkBytes = static_cast<uint64_t>(chunk.elementCount) * stride;
+			const uint64_t baseOffset = static_cast<uint64_t>(chunk.firstElement) * stride;
+
+			// Read in place, nothing is copied out of the ring
+			for (uint64_t i = 0; i < chunkBytes; i += 997) {
+				if (pPayload[sizeof(chunk) + i] != patternByte(chunk.hash, baseOffset + i)) mismatches++;
+			}
+			if (chunk.stream == Protocol::StreamPacked) vertices += chunk.elementCount;
+			break;
+		}
+		case Protocol::Instance: instances++; break;
+		case Protocol::EndSnapshot: snapshots++; break;
+		case Protocol::Shutdown: running = false; break;
+		default: break;
+		}
+
+		pChannel->endRead();
+	}
+
+	const double seconds = static_cast<double>(SceneChannel::now() - start) / 1e9;
+	std::sort(latencies.begin(), latencies.end());
+	auto percentile = [&latencies](double p) { return static_cast<double>(latencies[std::min(latencies.size() - 1, static_cast<size_t>(p * latencies.size()))]) / 1000.0; };
+
+	std::printf(
+		"Received %llu snapshots, %llu instances, %llu vertices in %llu records (%llu pattern mismatches)\n",
+		static_cast<unsigned long long>(snapshots), static_cast<unsigned long long>(instances), static_cast<unsigned long long>(vertices),
+		static_cast<unsigned long long>(latencies.size()), static_cast<unsigned long long>(mismatches)
+	);
+	std::printf("Throughput: %.1f MB/s (%.1f MB in %.3f s)\n", bytes / (1024.0 * 1024.0) / seconds, bytes / (1024.0 * 1024.0), seconds);
+	std::printf("Latency (us): p50 %.1f, p99 %.1f, max %.1f\n", percentile(0.5), percentile(0.99), percentile(1.0));
+
+	pChannel->close(); // Lets the producer exit
+	return mismatches == 0 ? 0 : 1;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc >= 3 && std::strcmp(argv[1], "produce") == 0) {
+		const uint32_t meshes = argc > 3 ? static_cast<uint32_t>(std::atoi(argv[3])) : 2000;
+		const uint32_t vertices = argc > 4 ? static_cast<uint32_t>(std::atoi(argv[4])) : 30000;
+		const uint32_t snapshots = argc > 5 ? static_cast<uint32_t>(std::atoi(argv[5])) : 4;
+		return produce(argv[2], meshes, vertices, snapshots);
+	}
+	if (argc >= 3 && std::strcmp(argv[1], "consume") == 0) return consume(argv[2]);
+
+	std::fprintf(stderr, "Usage: ChannelBench produce <name> [meshes] [vertices per mesh] [snapshots]\n       ChannelBench consume <name>\n");
+	return 1;
+}
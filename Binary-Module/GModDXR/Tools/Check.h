@@ -0,0 +1,32 @@
+#pragma once
+
+/*
+	Shared by the tests in Tools, a failed check is reported and counted rather than stopping the test,
+	so one run lists every broken rule, and finishChecks turns the count into main's exit status
+*/
+#include <cstdio>
+
+inline int& checkFailures()
+{
+	static int failures = 0;
+	return failures;
+}
+
+inline void check(bool condition, const char* pWhat)
+{
+	if (!condition) {
+		std::fprintf(stderr, "FAILED: %s\n", pWhat);
+		checkFailures()++;
+	}
+}
+
+// Returns main's exit status, non zero if any check failed
+inline int finishChecks(const char* pName)
+{
+	if (checkFailures()) {
+		std::fprintf(stderr, "%d checks failed\n", checkFailures());
+		return 1;
+	}
+	std::printf("All %s checks passed\n", pName);
+	return 0;
+}
@@ -0,0 +1,128 @@
+/*
+	Headless check of FrameWriter's readback ring (ReadbackRing.h) and worker pool (WorkerPool.h), with fake readbacks and encodes
+*/
+#include "Check.h"
+#include "ReadbackRing.h"
+#include "WorkerPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <vector>
+
+using namespace GModDXR;
+
+// As FrameWriter's
+static const size_t kMaxReadbacks = 8;
+static const uint64_t kReadbackLatency = 3;
+
+struct FakeReadback
+{
+	uint32_t sequence;
+	uint64_t frame; // Frame the readback was queued on
+};
+
+// A readback queued every frame is collected exactly kReadbackLatency frames later, and never early
+static void testLatency()
+{
+	ReadbackRing<FakeReadback> ring(kMaxReadbacks, kReadbackLatency);
+	uint64_t frame = 0;
+	bool onTime = true;
+	uint32_t collected = 0;
+	auto collect = [&](FakeReadback&& readback) {
+		onTime &= frame - readback.frame == kReadbackLatency;
+		collected++;
+	};
+
+	for (uint32_t i = 0; i < 100; i++) {
+		ring.push({ i, frame }, collect);
+		frame++;
+		ring.advance(collect);
+	}
+	check(onTime, "Readbacks are collected after the latency");
+	check(collected == 100 - (kReadbackLatency - 1) && ring.size() == kReadbackLatency - 1, "Only readbacks younger than the latency are in flight");
+	check(ring.getEarlyCollections() == 0, "Nothing is collected early while the ring has room");
+}
+
+/** Several captures a frame (more than the ring holds over the latency), each collected readback is encoded on the pool.
+	Every capture has to be collected in the order it was queued and encoded exactly once.
+*/
+static void testOverflow()
+{
+	const uint32_t kCapturesPerFrame = 5;
+	const uint32_t kFrames = 200;
+	const uint32_t kCaptures = kCapturesPerFrame * kFrames;
+
+	std::vector<uint32_t> collectedOrder;
+	std::vector<uint32_t> encodeCounts(kCaptures, 0);
+	std::mutex encodeMutex;
+	size_t maxInFlight = 0;
+
+	{
+		WorkerPool workers(3);
+		ReadbackRing<FakeReadback> ring(kMaxReadbacks, kReadbackLatency);
+		auto collect = [&](FakeReadback&& readback) {
+			collectedOrder.push_back(readback.sequence);
+			workers.enqueue([&, sequence = readback.sequence]() {
+				// Encodes take a varying amount of time, so the workers finish out of order
+				std::this_thread::sleep_for(std::chrono::microseconds((sequence * 2654435761U >> 20) % 200));
+				std::lock_guard<std::mutex> lock(encodeMutex);
+				encodeCounts[sequence]++;
+			});
+		};
+
+		uint32_t sequence = 0;
+		for (uint64_t frame = 0; frame < kFrames; frame++) {
+			for (uint32_t i = 0; i < kCapturesPerFrame; i++) {
+				ring.push({ sequence++, frame }, collect);
+				maxInFlight = std::max(maxInFlight, ring.size());
+			}
+			ring.advance(collect);
+		}
+
+		check(ring.getEarlyCollections() > 0, "A full ring collects early");
+		std::printf("Overflow: %zu of %u captures collected early, at most %zu in flight\n", ring.getEarlyCollections(), kCaptures, maxInFlight);
+
+		// As FrameWriter's destructor, then the pool's finishes the queue
+		ring.drain(collect);
+		check(ring.size() == 0, "Draining empties the ring");
+	}
+
+	check(maxInFlight <= kMaxReadbacks, "No more readbacks in flight than the ring holds");
+	check(collectedOrder.size() == kCaptures, "Every capture is collected");
+	bool ordered = true;
+	for (uint32_t i = 0; i < collectedOrder.size(); i++) ordered &= collectedOrder[i] == i;
+	check(ordered, "Captures are collected in the order they were queued");
+
+	bool once = true;
+	for (uint32_t count : encodeCounts) once &= count == 1;
+	check(once, "Every capture is encoded exactly once");
+}
+
+// Pending counts cover queued and running jobs, and reach zero once everything's done
+static void testPending()
+{
+	WorkerPool workers(2);
+	std::mutex gate;
+	std::unique_lock<std::mutex> hold(gate);
+	for (int i = 0; i < 6; i++) {
+		workers.enqueue([&gate]() { std::lock_guard<std::mutex> lock(gate); });
+	}
+	check(workers.getPendingCount() == 6, "Blocked jobs are pending");
+	hold.unlock();
+
+	const auto start = std::chrono::steady_clock::now();
+	while (workers.getPendingCount() != 0 && std::chrono::steady_clock::now() - start < std::chrono::seconds(10)) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	check(workers.getPendingCount() == 0, "Finished jobs aren't pending");
+}
+
+int main()
+{
+	testLatency();
+	testOverflow();
+	testPending();
+
+	return finishChecks("frame writer");
+}
@@ -0,0 +1,161 @@
+/*
+	Runs the tile schedule (ProgressiveSchedule.h) against a model of the renderer's buffers, where each tile records the view
+	(frame number of the camera) it was traced from, and checks what ends up on screen
+
+	A moving camera has to put a new image on screen every frame, whether or not the whole screen fits in a frame's tile budget,
+	and the history may only ever hold one view
+*/
+#include "Check.h"
+#include "ProgressiveSchedule.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+using namespace GModDXR;
+
+static const int kCleared = -1;
+static const int kMixed = -2;
+
+struct Model
+{
+	ProgressiveSchedule schedule;
+	std::vector<int> traced;  // View each tile of the traced output was traced from
+	int history = kCleared;   // View the accumulation buffers hold
+	int accumulations = 0;
+	int reprojections = 0;
+	int discards = 0;
+
+	explicit Model(uint32_t tileCount) : traced(tileCount, kCleared) {}
+
+	// Renders a frame from view and returns the displayed image
+	std::vector<int> frame(int view, bool reset, bool cameraMoved, bool useReprojection, uint32_t frameTiles)
+	{
+		const uint32_t tileCount = static_cast<uint32_t>(traced.size());
+		const ProgressiveSchedule::Frame f = schedule.beginFrame(reset, cameraMoved, useReprojection, tileCount, frameTiles);
+		if (f.clearHistory) history = kCleared;
+		if (f.clearOutput) std::fill(traced.begin(), traced.end(), kCleared);
+		check(f.firstTile + f.tiles <= tileCount, "Frames only trace tiles on screen");
+		check(f.tiles > 0, "Every frame traces something");
+		for (uint32_t tile = f.firstTile; tile < f.firstTile + f.tiles; tile++) traced[tile] = view;
+
+		const ProgressiveSchedule::SweepResult sweep = schedule.endFrame(1);
+		if (sweep == ProgressiveSchedule::SweepResult::Discard) discards++;
+		if (sweep == ProgressiveSchedule::SweepResult::Accumulate || sweep == ProgressiveSchedule::SweepResult::ReprojectAndAccumulate) {
+			int sweepView = traced[0];
+			for (int tileView : traced) {
+				if (tileView != sweepView) sweepView = kMixed;
+			}
+			check(sweepView == view, "Accumulated sweeps are traced from the current view alone");
+
+			if (sweep == ProgressiveSchedule::SweepResult::ReprojectAndAccumulate) {
+				check(history != kCleared, "Only existing history is reprojected");
+				reprojections++;
+				history = sweepView; // Warped to this view
+			}
+			check(history == kCleared || history == sweepView, "Samples are only added to history from the same view");
+			history = sweepView;
+			accumulations++;
+		}
+
+		return schedule.showHistory() ? std::vector<int>(tileCount, history) : traced;
+	}
+};
+
+static bool shows(const std::vector<int>& image, int view)
+{
+	for (int tileView : image) {
+		if (tileView == view) return true;
+	}
+	return false;
+}
+
+/** Settles a still camera, then moves it every frame and checks each displayed image changed and holds tiles from that frame's
+	view, then stops it and checks the accumulation picks up again.
+*/
+static void checkMovingCamera(const char* pName, uint32_t tileCount, uint32_t frameTiles, bool useReprojection)
+{
+	Model model(tileCount);
+	const int sweepFrames = static_cast<int>((tileCount + frameTiles - 1) / frameTiles);
+
+	int view = 0;
+	std::vector<int> displayed = model.frame(view, true, false, useReprojection, frameTiles);
+	for (int i = 0; i < sweepFrames * 3; i++) displayed = model.frame(view, false, false, useReprojection, frameTiles);
+	check(model.schedule.getAccumulatedSamples() >= 2, "A still camera accumulates");
+
+	// Start moving with the schedule part way through a sweep, where the old renderer restarted it and froze the screen
+	if (sweepFrames > 1) displayed = model.frame(view, false, false, useReprojection, frameTiles);
+
+	bool changedEveryFrame = true;
+	bool currentEveryFrame = true;
+	for (int i = 0; i < sweepFrames * 4; i++) {
+		view++;
+		const std::vector<int> next = model.frame(view, false, true, useReprojection, frameTiles);
+		changedEveryFrame = changedEveryFrame && next != displayed;
+		currentEveryFrame = currentEveryFrame && shows(next, view);
+		displayed = next;
+	}
+	std::printf("%s: %d accumulations, %d reprojections, %d discarded sweeps\n", pName, model.accumulations, model.reprojections, model.discards);
+	check(changedEveryFrame, "A moving camera changes the displayed image every frame");
+	check(currentEveryFrame, "A moving camera displays tiles traced from this frame's view every frame");
+
+	// At most one sweep finishes the mixed one, the next is accumulated from the still view
+	const int accumulationsBefore = model.accumulations;
+	for (int i = 0; i < sweepFrames * 2; i++) displayed = model.frame(view, false, false, useReprojection, frameTiles);
+	check(model.accumulations > accumulationsBefore, "Accumulation resumes once the camera stops");
+	check(model.schedule.showHistory() && model.history == view, "The history shown after stopping is from the final view");
+}
+
+// Whole screen fits in a frame: the history follows the camera by reprojection rather than being thrown away
+static void checkReprojection()
+{
+	Model model(1);
+	model.frame(0, true, false, true, 1);
+	model.frame(0, false, false, true, 1);
+	for (int view = 1; view <= 10; view++) model.frame(view, false, true, true, 1);
+	check(model.reprojections == 10, "Every camera move reprojects when the whole screen fits a frame");
+	check(model.schedule.getAccumulatedSamples() == 12, "Reprojected history keeps its samples");
+
+	// A texture changing mip reprojects in place without restarting the sweep
+	Model tiled(4);
+	tiled.frame(0, true, false, true, 1);
+	for (int i = 0; i < 4; i++) tiled.frame(0, false, false, true, 1);
+	tiled.schedule.requestReprojection();
+	check(tiled.schedule.getTileCursor() == 1, "Requesting reprojection doesn't restart the sweep");
+	for (int i = 0; i < 3; i++) tiled.frame(0, false, false, true, 1);
+	check(tiled.reprojections == 1 && tiled.schedule.getAccumulatedSamples() == 2, "Requested reprojection happens when the sweep completes");
+}
+
+// Resets throw away the traced output and history, restarting the sweep
+static void checkReset()
+{
+	Model model(8);
+	model.frame(0, true, false, true, 3);
+	model.frame(0, false, false, true, 3);
+	const std::vector<int> displayed = model.frame(1, true, false, true, 3);
+	check(model.schedule.getTileCursor() == 3 && !model.schedule.showHistory(), "A reset restarts the sweep and the history");
+	check(displayed[0] == 1 && displayed[3] == kCleared, "A reset clears the traced output");
+
+	model.frame(1, false, false, true, 3);
+	model.frame(1, false, false, true, 3);
+	const uint32_t samples = model.schedule.getAccumulatedSamples();
+	model.frame(1, false, false, true, 3);
+	model.frame(1, false, false, true, 5);
+	check(model.schedule.getAccumulatedSamples() == samples + 1, "Tile budget changes don't interrupt the sweep");
+
+	const ProgressiveSchedule::Frame resized = model.schedule.beginFrame(false, false, true, 12, 3);
+	check(resized.clearHistory && resized.clearOutput && resized.firstTile == 0, "A new tile count restarts like a reset");
+}
+
+int main()
+{
+	checkMovingCamera("Tiled with reprojection", 16, 3, true);
+	checkMovingCamera("Tiled without reprojection", 16, 3, false);
+	checkMovingCamera("Whole screen with reprojection", 1, 1, true);
+	checkMovingCamera("Whole screen without reprojection", 1, 1, false);
+	checkMovingCamera("Tiles fitting the budget", 4, 4, true);
+	checkReprojection();
+	checkReset();
+
+	return finishChecks("progressive schedule");
+}
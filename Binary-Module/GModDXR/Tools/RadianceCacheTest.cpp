@@ -0,0 +1,153 @@
+/*
+	Checks of the radiance cache's hash grid rules (Shaders/RadianceCacheMath.slangh), through its CPU implementation RadianceHashGrid
+*/
+#include "Check.h"
+#include "RadianceHashGrid.h"
+#include <cmath>
+#include <cstdio>
+
+using namespace GModDXR;
+using Vec3 = RadianceHashGrid::Vec3;
+
+static bool near(const Vec3& a, const Vec3& b, float tolerance)
+{
+	return std::fabs(a[0] - b[0]) <= tolerance && std::fabs(a[1] - b[1]) <= tolerance && std::fabs(a[2] - b[2]) <= tolerance;
+}
+
+static RadianceHashGrid::Settings smallSettings()
+{
+	RadianceHashGrid::Settings settings;
+	settings.capacity = 64;
+	settings.cellSize = 16.f;
+	settings.minWeight = 4.f;
+	settings.maxWeight = 8.f;
+	settings.maxAge = 3;
+	return settings;
+}
+
+// Cells only answer lookups once they have minWeight samples, and are keyed by cell and normal direction
+static void testLookups()
+{
+	RadianceHashGrid grid(smallSettings());
+	const Vec3 position = { 1.f, 2.f, 3.f }, up = { 0.f, 0.f, 1.f };
+	Vec3 L;
+
+	for (int i = 0; i < 3; i++) grid.record(position, up, { 1.f, 2.f, 0.5f });
+	check(!grid.lookup(position, up, L), "Records aren't visible before they're resolved");
+	grid.resolve();
+	check(grid.getLiveCells() == 1, "Resolving creates the cell");
+	check(!grid.lookup(position, up, L), "Cells with fewer than minWeight samples aren't used");
+
+	grid.record({ 5.f, 5.f, 5.f }, up, { 1.f, 2.f, 0.5f }); // Same cell
+	grid.resolve();
+	check(grid.lookup(position, up, L) && near(L, { 1.f, 2.f, 0.5f }, 1e-3f), "Cells return the mean of their samples once they have enough");
+	check(!grid.lookup(position, { 0.f, 0.f, -1.f }, L), "The other side of a surface is a different cell");
+	check(!grid.lookup({ 17.f, 2.f, 3.f }, up, L), "The neighbouring cell is a different cell");
+}
+
+// Past maxWeight a cell becomes a moving average, so it follows lighting changes
+static void testAdaptation()
+{
+	RadianceHashGrid grid(smallSettings());
+	const Vec3 position = { 1.f, 2.f, 3.f }, up = { 0.f, 0.f, 1.f };
+	Vec3 L;
+
+	for (int frame = 0; frame < 4; frame++) {
+		for (int i = 0; i < 4; i++) grid.record(position, up, { 1.f, 1.f, 1.f });
+		grid.resolve();
+	}
+	for (int frame = 0; frame < 20; frame++) {
+		for (int i = 0; i < 4; i++) grid.record(position, up, { 3.f, 3.f, 3.f });
+		grid.resolve();
+	}
+	check(grid.lookup(position, up, L) && near(L, { 3.f, 3.f, 3.f }, 1e-2f), "Capped cells move to new lighting");
+}
+
+// Samples are clamped to [0, kRadianceCacheMaxRadiance]
+static void testClamp()
+{
+	RadianceHashGrid grid(smallSettings());
+	const Vec3 position = { 100.f, 0.f, 0.f }, up = { 0.f, 0.f, 1.f };
+	Vec3 L;
+
+	for (int i = 0; i < 8; i++) grid.record(position, up, { 1e9f, 0.f, -5.f });
+	grid.resolve();
+	check(grid.lookup(position, up, L) && L[0] == RadianceCacheMath::kRadianceCacheMaxRadiance && L[2] == 0.f, "Fireflies and negative samples are clamped");
+}
+
+/** A cell recorded to far more often than its fixed point sums could hold at maximum radiance (2^32 / (256 * 1024) = 16384 records).
+	Only the first kRadianceCacheMaxRecords are summed, so the mean stays right instead of wrapping around.
+*/
+static void testOverflow()
+{
+	RadianceHashGrid::Settings settings = smallSettings();
+	settings.maxWeight = 1e6f;
+	RadianceHashGrid grid(settings);
+	const Vec3 position = { 1.f, 2.f, 3.f }, up = { 0.f, 0.f, 1.f };
+	const float kMax = RadianceCacheMath::kRadianceCacheMaxRadiance;
+	Vec3 L;
+
+	for (int i = 0; i < 100000; i++) grid.record(position, up, { kMax, kMax * 0.5f, 1.f });
+	grid.resolve();
+	check(grid.lookup(position, up, L) && near(L, { kMax, kMax * 0.5f, 1.f }, 1e-3f), "A cell recorded to 100000 times at maximum radiance keeps its mean");
+
+	// Above the cap the records past it are dropped, not wrapped, so a change partway through the frame is only seen up to the cap
+	RadianceHashGrid mixed(settings);
+	for (uint32_t i = 0; i < RadianceCacheMath::kRadianceCacheMaxRecords; i++) mixed.record(position, up, { 2.f, 2.f, 2.f });
+	for (int i = 0; i < 50000; i++) mixed.record(position, up, { kMax, kMax, kMax });
+	mixed.resolve();
+	check(mixed.lookup(position, up, L) && near(L, { 2.f, 2.f, 2.f }, 1e-3f), "Records past the cap don't change the sums");
+
+	const uint64_t maxSum = static_cast<uint64_t>(RadianceCacheMath::kRadianceCacheMaxRecords) * RadianceCacheMath::radianceCacheToFixed(kMax);
+	check(maxSum <= UINT32_MAX, "The most a cell can sum fits in its fixed point sums");
+}
+
+// Cells that aren't recorded to or looked up in maxAge frames are evicted
+static void testEviction()
+{
+	RadianceHashGrid grid(smallSettings());
+	const Vec3 position = { 1.f, 2.f, 3.f }, up = { 0.f, 0.f, 1.f };
+	Vec3 L;
+
+	for (int i = 0; i < 8; i++) grid.record(position, up, { 1.f, 1.f, 1.f });
+	grid.resolve();
+	for (int frame = 0; frame < 5; frame++) grid.resolve();
+	check(grid.getLiveCells() == 0 && !grid.lookup(position, up, L), "Unused cells are evicted");
+
+	for (int i = 0; i < 8; i++) grid.record(position, up, { 1.f, 1.f, 1.f });
+	grid.resolve();
+	bool found = true;
+	for (int frame = 0; frame < 10; frame++) {
+		found &= grid.lookup(position, up, L);
+		grid.resolve();
+	}
+	check(found && grid.getLiveCells() == 1, "Lookups keep a cell alive");
+}
+
+// More distinct cells than the grid holds, records past the probe limit are dropped rather than overwriting other cells
+static void testSaturation()
+{
+	RadianceHashGrid grid(smallSettings());
+	const Vec3 up = { 0.f, 0.f, 1.f };
+	Vec3 L;
+
+	uint32_t placed = 0;
+	for (int i = 0; i < 200; i++) placed += grid.record({ i * 16.f + 1.f, 0.f, 0.f }, up, { 1.f, 1.f, 1.f });
+	grid.resolve();
+	check(placed < 200 && grid.getLiveCells() == placed && placed <= grid.getSettings().capacity, "A full grid drops records");
+
+	grid.clear();
+	check(grid.getLiveCells() == 0 && !grid.lookup({ 1.f, 0.f, 0.f }, up, L), "Clearing drops every cell");
+}
+
+int main()
+{
+	testLookups();
+	testAdaptation();
+	testClamp();
+	testOverflow();
+	testEviction();
+	testSaturation();
+
+	return finishChecks("radiance cache");
+}
@@ -0,0 +1,314 @@
+/*
+	Checks of the reprojection pass's history rejection and clamping (Shaders/ReprojectionMath.slangh), run over a CPU copy of Reproject.cs.slang
+
+	The scene is a wall with a box in front of it, seen by a camera that moves sideways between frames, so part of the wall
+	the box hid in the previous frame comes into view and has to restart from no history
+*/
+#include "Check.h"
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+namespace Reprojection
+{
+	// Just enough of Falcor's glm types for the shared header, matrices are column major like glm's
+	struct float2
+	{
+		float x, y;
+		float2(float x, float y) : x(x), y(y) {}
+	};
+	inline float2 operator*(float2 a, float2 b) { return float2(a.x * b.x, a.y * b.y); }
+	inline float2 operator/(float2 a, float s) { return float2(a.x / s, a.y / s); }
+
+	struct float3
+	{
+		float x, y, z;
+		float3(float x, float y, float z) : x(x), y(y), z(z) {}
+	};
+	inline float dot(float3 a, float3 b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+
+	struct float4
+	{
+		float x, y, z, w;
+		float4() : x(0.f), y(0.f), z(0.f), w(0.f) {}
+		explicit float4(float s) : x(s), y(s), z(s), w(s) {}
+		float4(float x, float y, float z, float w) : x(x), y(y), z(z), w(w) {}
+		float4(float3 v, float w) : x(v.x), y(v.y), z(v.z), w(w) {}
+		float& operator[](int i) { return (&x)[i]; }
+		float operator[](int i) const { return (&x)[i]; }
+	};
+	inline float4 operator*(float4 v, float s) { return float4(v.x * s, v.y * s, v.z * s, v.w * s); }
+	inline float4 operator+(float4 a, float4 b) { return float4(a.x + b.x, a.y + b.y, a.z + b.z, a.w + b.w); }
+
+	struct float4x4
+	{
+		float4 columns[4];
+		float4& operator[](int i) { return columns[i]; }
+		const float4& operator[](int i) const { return columns[i]; }
+	};
+	inline float4 operator*(const float4x4& m, float4 v)
+	{
+		float4 result;
+		for (int row = 0; row < 4; row++) {
+			for (int column = 0; column < 4; column++) result[row] += m[column][row] * v[column];
+		}
+		return result;
+	}
+
+#include "../Shaders/ReprojectionMath.slangh"
+}
+
+using namespace Reprojection;
+
+static const uint32_t kWidth = 160;
+static const uint32_t kHeight = 90;
+static const float kMaxHistory = 256.f; // As Renderer's default maxHistorySamples
+
+// One frame's G-buffer and accumulation buffers, laid out row by row like the textures
+struct Frame
+{
+	std::vector<float4> position; // World position and view depth (0 depth for a miss)
+	std::vector<float4> normal;
+	std::vector<float4> sum;      // Accumulated radiance, alpha is the sample count
+	std::vector<float4> correction;
+	std::vector<int> surface;     // What each pixel sees, for checking the result (-1 for sky)
+};
+
+// Same as Reproject.cs.slang, one pixel at a time
+static void reprojectHistory(const Frame& previous, const float4x4& prevViewProj, float maxHistory, Frame& current)
+{
+	const size_t pixelCount = static_cast<size_t>(kWidth) * kHeight;
+	current.sum.assign(pixelCount, float4(0.f));
+	current.correction.assign(pixelCount, float4(0.f));
+
+	for (size_t i = 0; i < pixelCount; i++) {
+		const float4& position = current.position[i];
+		float2 prevPixel(0.f, 0.f);
+		float expectedDepth;
+		if (position.w <= 0.f || !reprojectPosition(float3(position.x, position.y, position.z), prevViewProj, float2(kWidth, kHeight), prevPixel, expectedDepth)) continue;
+
+		const size_t historyIndex = static_cast<size_t>(prevPixel.y) * kWidth + static_cast<size_t>(prevPixel.x);
+		const float4& normal = current.normal[i];
+		const float4& historyNormal = previous.normal[historyIndex];
+		if (!isHistoryValid(expectedDepth, previous.position[historyIndex].w, float3(normal.x, normal.y, normal.z), float3(historyNormal.x, historyNormal.y, historyNormal.z))) continue;
+
+		const float scale = historyScale(previous.sum[historyIndex].w, maxHistory);
+		current.sum[i] = previous.sum[historyIndex] * scale;
+		current.correction[i] = previous.correction[historyIndex] * scale;
+	}
+}
+
+// Camera looking down -z with a 60 degree vertical field of view, like glm::perspective * glm::lookAt with no rotation
+struct Camera
+{
+	float x = 0.f;
+	float y = 0.f;
+	float z = 0.f;
+
+	static float focal() { return 1.f / std::tan(30.f * 3.14159265f / 180.f); }
+	static float aspect() { return static_cast<float>(kWidth) / kHeight; }
+
+	float4x4 getViewProj() const
+	{
+		const float nearZ = 0.1f, farZ = 1000.f;
+		float4x4 m;
+		m[0][0] = focal() / aspect();
+		m[1][1] = focal();
+		m[2][2] = -(farZ + nearZ) / (farZ - nearZ);
+		m[2][3] = -1.f;
+		m[3][2] = -2.f * farZ * nearZ / (farZ - nearZ);
+		// Translation by -position, folded into the last column
+		for (int row = 0; row < 4; row++) m[3][row] -= m[0][row] * x + m[1][row] * y + m[2][row] * z;
+		return m;
+	}
+};
+
+// A quad facing +z at depth z, covering [-halfSize, halfSize] in x and y
+struct Quad
+{
+	float z;
+	float halfSize;
+};
+
+static const Quad kBox = { -5.f, 1.f };
+static const Quad kWall = { -10.f, 8.f };
+
+// Which surface is hit first along a ray from origin, and where (-1 for sky)
+static int trace(float ox, float oy, float oz, float dx, float dy, float dz, float& hx, float& hy, float& hz)
+{
+	for (int surface = 0; surface < 2; surface++) {
+		const Quad& quad = surface == 0 ? kBox : kWall;
+		const float t = (quad.z - oz) / dz;
+		hx = ox + dx * t;
+		hy = oy + dy * t;
+		hz = quad.z;
+		if (t > 0.f && std::fabs(hx) <= quad.halfSize && std::fabs(hy) <= quad.halfSize) return surface;
+	}
+	return -1;
+}
+
+// Fills the G-buffer the path tracer would write from camera, through pixel centres
+static Frame renderGBuffer(const Camera& camera)
+{
+	Frame frame;
+	for (uint32_t py = 0; py < kHeight; py++) {
+		for (uint32_t px = 0; px < kWidth; px++) {
+			const float ndcX = (px + 0.5f) / kWidth * 2.f - 1.f;
+			const float ndcY = 1.f - (py + 0.5f) / kHeight * 2.f;
+			float hx, hy, hz;
+			const int surface = trace(camera.x, camera.y, camera.z, ndcX * Camera::aspect() / Camera::focal(), ndcY / Camera::focal(), -1.f, hx, hy, hz);
+
+			frame.surface.push_back(surface);
+			frame.position.push_back(surface < 0 ? float4(0.f) : float4(hx, hy, hz, camera.z - hz));
+			frame.normal.push_back(surface < 0 ? float4(0.f) : float4(0.f, 0.f, 1.f, 0.f));
+		}
+	}
+	return frame;
+}
+
+// Gives every pixel of the previous frame its own radiance and a sample count, some of which are over the cap
+static void fillHistory(Frame& frame)
+{
+	const size_t pixelCount = frame.position.size();
+	frame.sum.resize(pixelCount);
+	frame.correction.resize(pixelCount);
+	for (size_t i = 0; i < pixelCount; i++) {
+		const float count = static_cast<float>(1 + (i * 37) % 1000);
+		frame.sum[i] = float4(static_cast<float>(i) * count, 0.5f * count, 0.25f * count, count);
+		frame.correction[i] = float4(0.125f * count, 0.f, 0.f, 0.f);
+	}
+}
+
+/** The camera moves right between frames, which uncovers part of the wall on the box's left.
+	Those pixels (and sky) must restart from nothing, and everything seen in both frames has to keep its own texel's history.
+*/
+static void testDisocclusion()
+{
+	Camera previousCamera, currentCamera;
+	currentCamera.x = 0.6f;
+
+	Frame previous = renderGBuffer(previousCamera);
+	fillHistory(previous);
+	Frame current = renderGBuffer(currentCamera);
+	reprojectHistory(previous, previousCamera.getViewProj(), kMaxHistory, current);
+
+	uint32_t disoccluded = 0, wrongHistory = 0, keptStale = 0, droppedVisible = 0, kept = 0, sky = 0, skyKept = 0;
+	for (uint32_t py = 0; py < kHeight; py++) {
+		for (uint32_t px = 0; px < kWidth; px++) {
+			const size_t i = static_cast<size_t>(py) * kWidth + px;
+			const bool hasHistory = current.sum[i].w > 0.f;
+			if (current.surface[i] < 0) {
+				sky++;
+				skyKept += hasHistory;
+				continue;
+			}
+
+			// Where the previous camera saw this point, worked out directly rather than with the shared header
+			const float4& position = current.position[i];
+			const float depth = previousCamera.z - position.z;
+			const float prevX = ((position.x - previousCamera.x) / depth * Camera::focal() / Camera::aspect() * 0.5f + 0.5f) * kWidth;
+			const float prevY = (0.5f - (position.y - previousCamera.y) / depth * Camera::focal() * 0.5f) * kHeight;
+			if (prevX < 0.f || prevY < 0.f || prevX >= kWidth || prevY >= kHeight) {
+				keptStale += hasHistory;
+				continue;
+			}
+			const size_t historyIndex = static_cast<size_t>(prevY) * kWidth + static_cast<size_t>(prevX);
+
+			// Whether the point itself was hidden from the previous camera
+			float hx, hy, hz;
+			const int seenBefore = trace(previousCamera.x, previousCamera.y, previousCamera.z, position.x - previousCamera.x, position.y - previousCamera.y, position.z - previousCamera.z, hx, hy, hz);
+			const bool visibleBefore = seenBefore == current.surface[i];
+			disoccluded += !visibleBefore;
+
+			// Along the box's silhouette, the nearest texel can see the other surface even though the point was visible (or the other way round)
+			if (visibleBefore != (previous.surface[historyIndex] == current.surface[i])) continue;
+
+			if (!visibleBefore) {
+				keptStale += hasHistory;
+			} else if (!hasHistory) {
+				droppedVisible++;
+			} else {
+				kept++;
+				const float4& history = previous.sum[historyIndex];
+				const float scale = current.sum[i].w / history.w;
+				wrongHistory += current.sum[i].x != history.x * scale || current.correction[i].x != previous.correction[historyIndex].x * scale;
+			}
+		}
+	}
+
+	std::printf("Disocclusion: %u pixels kept history, %u were disoccluded, %u sky\n", kept, disoccluded, sky);
+	check(disoccluded > 100, "Moving the camera disoccludes part of the wall");
+	check(keptStale == 0, "Disoccluded and previously off screen pixels restart from no history");
+	check(skyKept == 0, "Sky restarts from no history");
+	check(droppedVisible == 0, "Surfaces seen in both frames keep their history");
+	check(kept > kWidth * kHeight / 2, "Most of the frame keeps its history");
+	check(wrongHistory == 0, "History comes from the texel the point was seen in");
+}
+
+// The tolerances themselves, on values either side of them
+static void testTolerances()
+{
+	const float3 up(0.f, 1.f, 0.f);
+	check(isHistoryValid(100.f, 102.f, up, up), "Depth within the tolerance is accepted");
+	check(!isHistoryValid(100.f, 105.f, up, up), "Depth past the tolerance is rejected");
+	check(!isHistoryValid(100.f, 95.f, up, up), "The depth tolerance applies both ways");
+	check(isHistoryValid(1000.f, 1020.f, up, up) && !isHistoryValid(1.f, 1.05f, up, up), "The depth tolerance is relative to distance");
+	check(!isHistoryValid(100.f, 0.f, up, up), "A miss in the previous frame is rejected");
+
+	const float tilt = 0.5f; // About 27 degrees, a cosine under 0.9
+	const float3 tilted(0.f, 1.f / std::sqrt(1.f + tilt * tilt), tilt / std::sqrt(1.f + tilt * tilt));
+	const float3 nudged(0.f, 1.f / std::sqrt(1.01f), 0.1f / std::sqrt(1.01f));
+	check(!isHistoryValid(100.f, 100.f, up, tilted), "A different surface orientation is rejected");
+	check(isHistoryValid(100.f, 100.f, up, nudged), "A slightly different normal is accepted");
+}
+
+// Reprojected history never carries more than maxHistory samples, and clamping keeps each pixel's mean
+static void testClamping()
+{
+	Camera camera;
+	Frame previous = renderGBuffer(camera);
+	fillHistory(previous);
+	Frame current = renderGBuffer(camera);
+	reprojectHistory(previous, camera.getViewProj(), kMaxHistory, current);
+
+	bool capped = true, meanKept = true, underCapUntouched = true;
+	uint32_t overCap = 0;
+	for (size_t i = 0; i < current.sum.size(); i++) {
+		if (current.surface[i] < 0) continue;
+		const float4& before = previous.sum[i];
+		const float4& after = current.sum[i];
+		capped &= after.w <= kMaxHistory * (1.f + 1e-6f);
+		meanKept &= std::fabs(after.x / after.w - before.x / before.w) <= 1e-5f * std::fabs(before.x / before.w) && std::fabs(after.y / after.w - 0.5f) < 1e-6f;
+		if (before.w > kMaxHistory) {
+			overCap++;
+			capped &= std::fabs(after.w - kMaxHistory) < 1e-3f;
+		} else {
+			underCapUntouched &= after.x == before.x && after.w == before.w;
+		}
+	}
+	check(overCap > 0, "Some history is over the cap");
+	check(capped, "History over the cap is scaled down to exactly maxHistory samples");
+	check(underCapUntouched, "History under the cap is left alone");
+	check(meanKept, "Clamping keeps each pixel's mean");
+
+	// Accumulating behind a static camera, a change in lighting has to show up rather than be outweighed by old samples forever
+	float4 sum(0.f, 0.f, 0.f, 0.f);
+	for (int frame = 0; frame < 1000; frame++) sum = sum * historyScale(sum.w, kMaxHistory) + float4(0.f, 0.f, 0.f, 1.f);
+	float maxCount = 0.f;
+	for (int frame = 0; frame < 2000; frame++) {
+		sum = sum * historyScale(sum.w, kMaxHistory) + float4(1.f, 0.f, 0.f, 1.f);
+		maxCount = std::fmax(maxCount, sum.w);
+	}
+	check(maxCount <= kMaxHistory + 1.f, "The count stays at the cap plus the frame's sample");
+	check(sum.x / sum.w > 0.99f, "Old samples fade out once the cap is reached");
+}
+
+int main()
+{
+	testDisocclusion();
+	testTolerances();
+	testClamping();
+
+	return finishChecks("reprojection");
+}
@@ -0,0 +1,272 @@
+/*
+	Convergence and discrepancy checks for the path tracer's low discrepancy sample patterns (Shaders/SamplePatternMath.slangh)
+
+	Every pixel integrates 2D functions over pairs of dimensions, both paired ones (a direction), which should beat random
+	sampling, and ones from different decisions and bounces, which are only padded together so should converge like
+	random sampling does, but would converge to the wrong value if the pattern correlated them
+*/
+#include "BlueNoise.h"
+#include "Check.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <vector>
+
+namespace SamplePattern
+{
+	using uint = uint32_t;
+	using std::max;
+	using std::min;
+#include "../Shaders/SamplePatternMath.slangh"
+}
+
+using namespace GModDXR;
+using SamplePattern::uint;
+
+static const uint kMaskSize = 64; // As kBlueNoiseSize in PathSampler.slang
+static const uint kTestPixels = 32; // Convergence is checked over the top left corner of the screen
+static const uint kDimsCamera = 2;
+static const uint kDimsPerBounce = 12;
+
+static float toFloat(uint fixed)
+{
+	return static_cast<float>(fixed >> 8) / 16777216.f;
+}
+
+// Mirrors PathSampler.next()
+using Pattern = std::function<uint(uint x, uint y, uint dimension, uint sampleNumber)>;
+
+static Pattern blueNoisePattern(const std::vector<float>& mask)
+{
+	return [&mask](uint x, uint y, uint dimension, uint sampleNumber) {
+		const uint dimHash = SamplePattern::jenkinsHash(dimension);
+		const uint tx = (x + dimHash) % kMaskSize;
+		const uint ty = (y + (dimHash >> 16)) % kMaskSize;
+		return SamplePattern::blueNoiseSample(SamplePattern::blueNoiseMaskToFixed(mask[ty * kMaskSize + tx]), dimension, sampleNumber);
+	};
+}
+
+static Pattern sobolPattern()
+{
+	return [](uint x, uint y, uint dimension, uint sampleNumber) {
+		const uint pixelSeed = SamplePattern::jenkinsHash(x ^ SamplePattern::jenkinsHash(y));
+		return SamplePattern::sobolSample(pixelSeed, dimension, sampleNumber);
+	};
+}
+
+// Independent uniform random numbers per pixel, dimension and sample, the baseline the patterns have to beat
+// (PCG's output hash, jenkinsHash of consecutive sample numbers isn't random enough to be the baseline)
+static uint pcgHash(uint v)
+{
+	const uint state = v * 747796405u + 2891336453u;
+	const uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+	return (word >> 22u) ^ word;
+}
+
+static Pattern randomPattern()
+{
+	return [](uint x, uint y, uint dimension, uint sampleNumber) {
+		return pcgHash(sampleNumber + pcgHash(dimension + pcgHash(x + pcgHash(y))));
+	};
+}
+
+// The blue noise pattern as it was, every dimension rotated over time by the same golden ratio step
+// Kept to show the checks catch the dimensions being correlated
+static Pattern goldenRatioPattern(const std::vector<float>& mask)
+{
+	return [&mask](uint x, uint y, uint dimension, uint sampleNumber) {
+		const uint dimHash = SamplePattern::jenkinsHash(dimension);
+		const uint tx = (x + dimHash) % kMaskSize;
+		const uint ty = (y + (dimHash >> 16)) % kMaskSize;
+		return SamplePattern::blueNoiseMaskToFixed(mask[ty * kMaskSize + tx]) + sampleNumber * 0x9e3779b9u;
+	};
+}
+
+struct Integrand
+{
+	const char* pName;
+	double reference;
+	double deviation; // Standard deviation of a single sample, for the error uniform random sampling would give
+	std::function<double(double, double)> f;
+};
+
+static const Integrand kIntegrands[] = {
+	{ "product", 0.25, std::sqrt(1.0 / 9.0 - 1.0 / 16.0), [](double u, double v) { return u * v; } },
+	{ "quarter disk", 0.78539816339744831, std::sqrt(0.78539816339744831 * (1.0 - 0.78539816339744831)), [](double u, double v) { return u * u + v * v < 1.0 ? 1.0 : 0.0; } },
+	{ "corner", 0.25, std::sqrt(0.25 * 0.75), [](double u, double v) { return u < 0.5 && v > 0.5 ? 1.0 : 0.0; } },
+};
+
+// RMS error over the test pixels of the per pixel estimates after sampleCount samples
+static double rmsError(const Pattern& pattern, uint dimA, uint dimB, const Integrand& integrand, uint sampleCount)
+{
+	double sumSquared = 0.0;
+	for (uint y = 0; y < kTestPixels; y++) {
+		for (uint x = 0; x < kTestPixels; x++) {
+			double sum = 0.0;
+			for (uint i = 0; i < sampleCount; i++) sum += integrand.f(toFloat(pattern(x, y, dimA, i)), toFloat(pattern(x, y, dimB, i)));
+			const double error = sum / sampleCount - integrand.reference;
+			sumSquared += error * error;
+		}
+	}
+	return std::sqrt(sumSquared / (kTestPixels * kTestPixels));
+}
+
+struct DimensionPair
+{
+	const char* pName;
+	uint a;
+	uint b;
+	bool stratified; // Both dimensions come from the same 2D point
+};
+
+static const DimensionPair kPairs[] = {
+	{ "lens", 0, 1, true },
+	{ "first BSDF direction", kDimsCamera + 2, kDimsCamera + 3, true },
+	{ "light position", kDimsCamera + 4 + 2, kDimsCamera + 4 + 3, true },
+	{ "lens and BSDF lobe", 0, kDimsCamera, false },
+	{ "BSDF and light", kDimsCamera + 2, kDimsCamera + 4 + 2, false },
+	{ "light selection and position", kDimsCamera + 4 + 1, kDimsCamera + 4 + 2, false },
+	{ "first and second bounce", kDimsCamera + 2, kDimsCamera + kDimsPerBounce + 2, false },
+	{ "roulette and next BSDF", kDimsCamera + 10, kDimsCamera + kDimsPerBounce + 3, false },
+};
+
+/** Stratified pairs have to beat uniform random sampling by a margin, the rest have to converge at least as fast as it
+	(random sampling's error drops by 4x over 16x the samples, a biased estimate stops improving).
+	\return False if any pair of dimensions failed.
+*/
+static bool checkConvergence(const char* pPatternName, const Pattern& pattern, bool report)
+{
+	const uint kFew = 64;
+	const uint kMany = 1024;
+
+	bool converged = true;
+	for (const DimensionPair& pair : kPairs) {
+		for (const Integrand& integrand : kIntegrands) {
+			const double few = rmsError(pattern, pair.a, pair.b, integrand, kFew);
+			const double many = rmsError(pattern, pair.a, pair.b, integrand, kMany);
+			const double random = integrand.deviation / std::sqrt(static_cast<double>(kMany));
+
+			const bool converging = many < 0.4 * few || many < 0.1 * random;
+			const bool ok = converging && many < (pair.stratified ? 0.5 : 1.5) * random;
+			if (report) {
+				std::printf("%-12s %-29s %-13s RMS error %.5f at %u samples, %.5f at %u (random %.5f)%s\n",
+					pPatternName, pair.pName, integrand.pName, few, kFew, many, kMany, random, ok ? "" : " <- not converging");
+			}
+			converged &= ok;
+		}
+	}
+	return converged;
+}
+
+/** L2 star discrepancy of a pixel's first sampleCount points in a pair of dimensions (Warnock's formula), the RMS over every
+	box anchored at the origin of the difference between the fraction of points in it and its area.
+	Uniform random points have an expected squared discrepancy of (1/4 - 1/9) / sampleCount.
+*/
+static double starDiscrepancy(const Pattern& pattern, uint x, uint y, uint dimA, uint dimB, uint sampleCount)
+{
+	std::vector<double> u(sampleCount), v(sampleCount);
+	for (uint i = 0; i < sampleCount; i++) {
+		u[i] = toFloat(pattern(x, y, dimA, i));
+		v[i] = toFloat(pattern(x, y, dimB, i));
+	}
+
+	double single = 0.0;
+	double pairs = 0.0;
+	for (uint i = 0; i < sampleCount; i++) {
+		single += (1.0 - u[i] * u[i]) * (1.0 - v[i] * v[i]);
+		for (uint j = 0; j < sampleCount; j++) pairs += (1.0 - std::max(u[i], u[j])) * (1.0 - std::max(v[i], v[j]));
+	}
+	const double n = sampleCount;
+	return std::sqrt(std::max(1.0 / 9.0 - single / (2.0 * n) + pairs / (n * n), 0.0));
+}
+
+// RMS over 8x8 pixels of the star discrepancy of each pixel's points
+static double meanDiscrepancy(const Pattern& pattern, const DimensionPair& pair, uint sampleCount)
+{
+	double sumSquared = 0.0;
+	for (uint y = 0; y < 8; y++) {
+		for (uint x = 0; x < 8; x++) {
+			const double d = starDiscrepancy(pattern, x, y, pair.a, pair.b, sampleCount);
+			sumSquared += d * d;
+		}
+	}
+	return std::sqrt(sumSquared / 64.0);
+}
+
+/** Discrepancy of the 2D projections every pattern is used in.
+	Owen scrambled Sobol points are stratified in the paired dimensions, so have to beat random points by a margin there,
+	neither pattern may be worse than random points in any pair, and random points have to match their expected discrepancy,
+	to show the measure itself is right.
+*/
+static void checkDiscrepancy(const std::vector<float>& mask)
+{
+	const uint kSamples = 256;
+	const double expected = std::sqrt((1.0 / 4.0 - 1.0 / 9.0) / kSamples);
+
+	const Pattern random = randomPattern();
+	const Pattern sobol = sobolPattern();
+	const Pattern blueNoise = blueNoisePattern(mask);
+	bool randomMatches = true;
+	bool sobolBeatsRandom = true;
+	bool noWorseThanRandom = true;
+	for (const DimensionPair& pair : kPairs) {
+		const double dRandom = meanDiscrepancy(random, pair, kSamples);
+		const double dSobol = meanDiscrepancy(sobol, pair, kSamples);
+		const double dBlueNoise = meanDiscrepancy(blueNoise, pair, kSamples);
+		std::printf("L2 star discrepancy %-29s at %u samples: random %.5f, Sobol %.5f, blue noise %.5f (expected random %.5f)\n",
+			pair.pName, kSamples, dRandom, dSobol, dBlueNoise, expected);
+
+		randomMatches &= dRandom > 0.75 * expected && dRandom < 1.25 * expected;
+		if (pair.stratified) sobolBeatsRandom &= dSobol < 0.25 * dRandom;
+		noWorseThanRandom &= dSobol < 1.25 * expected && dBlueNoise < 1.25 * expected;
+	}
+
+	check(randomMatches, "Random points have the expected discrepancy");
+	check(sobolBeatsRandom, "Owen scrambled Sobol points have a much lower discrepancy than random ones in paired dimensions");
+	check(noWorseThanRandom, "Neither pattern is more clumped than random points in any pair of dimensions");
+}
+
+/** Each dimension's values across the screen for a single sample should keep the mask's lack of low frequencies.
+	Measured as the spread of 8x8 tile means, which is 1 / sqrt(12 * 64) for white noise.
+*/
+static void checkBlueNoise(const Pattern& pattern)
+{
+	const uint kTile = 8;
+	const double white = 1.0 / std::sqrt(12.0 * kTile * kTile);
+
+	double worst = 0.0;
+	for (uint dimension = 0; dimension < kDimsCamera + kDimsPerBounce * 2; dimension++) {
+		for (uint sample : { 0U, 1U, 7U, 100U }) {
+			double sumSquared = 0.0;
+			for (uint ty = 0; ty < kMaskSize; ty += kTile) {
+				for (uint tx = 0; tx < kMaskSize; tx += kTile) {
+					double mean = 0.0;
+					for (uint y = ty; y < ty + kTile; y++) {
+						for (uint x = tx; x < tx + kTile; x++) mean += toFloat(pattern(x, y, dimension, sample));
+					}
+					mean = mean / (kTile * kTile) - 0.5;
+					sumSquared += mean * mean;
+				}
+			}
+			worst = std::max(worst, std::sqrt(sumSquared / ((kMaskSize / kTile) * (kMaskSize / kTile))));
+		}
+	}
+
+	std::printf("Blue noise: worst 8x8 tile mean spread %.4f (white noise %.4f)\n", worst, white);
+	check(worst < 0.5 * white, "Blue noise pattern keeps the mask's spectrum on screen");
+}
+
+int main()
+{
+	const std::vector<float> mask = generateBlueNoise(kMaskSize);
+
+	check(checkConvergence("Blue noise", blueNoisePattern(mask), true), "Blue noise pattern converges in every pair of dimensions");
+	check(checkConvergence("Sobol", sobolPattern(), true), "Sobol pattern converges in every pair of dimensions");
+	check(!checkConvergence("Golden ratio", goldenRatioPattern(mask), false), "Correlated dimensions are detected");
+	checkDiscrepancy(mask);
+	checkBlueNoise(blueNoisePattern(mask));
+
+	return finishChecks("sampler");
+}
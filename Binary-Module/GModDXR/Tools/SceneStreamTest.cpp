@@ -0,0 +1,322 @@
+/*
+	Round trip of the scene protocol through a real SceneChannel, using the same send and receive code as the module and renderer (SceneStream.h)
+*/
+#include "Check.h"
+#include "SceneStream.h"
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace GModDXR;
+
+// Small enough that big meshes are split into many chunks and the ring wraps several times
+static const uint64_t kCapacity = 64 * 1024;
+static const uint32_t kTimeoutMs = 10000;
+
+struct TestMesh
+{
+	Protocol::MeshMessage header = {};
+	std::string name;
+	std::vector<uint8_t> streams[Protocol::kStreamCount];
+
+	MeshStreams getStreams() const
+	{
+		MeshStreams mesh;
+		mesh.header = header;
+		mesh.name = name;
+		for (uint32_t stream = 0; stream < Protocol::kStreamCount; stream++) mesh.pStreams[stream] = streams[stream].data();
+		return mesh;
+	}
+};
+
+struct TestInstance
+{
+	Protocol::InstanceMessage message = {};
+	InstanceStrings strings;
+};
+
+static TestMesh makeMesh(uint64_t hash, uint32_t vertexCount, uint32_t flags, const std::string& name)
+{
+	TestMesh mesh;
+	mesh.header.hash = hash;
+	mesh.header.vertexCount = vertexCount;
+	mesh.header.flags = flags;
+	mesh.name = name;
+	mesh.header.nameLength = static_cast<uint32_t>(name.size()); // As sendMesh fills it in, so received headers compare equal
+
+	for (uint32_t stream = 0; stream < Protocol::kStreamCount; stream++) {
+		if (!hasStream(mesh.header, stream)) continue;
+		std::vector<uint8_t>& bytes = mesh.streams[stream];
+		bytes.resize(static_cast<size_t>(getStreamElementCount(mesh.header, stream)) * Protocol::getStreamStride(stream));
+		for (size_t i = 0; i < bytes.size(); i++) bytes[i] = static_cast<uint8_t>((hash * 31 + stream * 7 + i * 2654435761ULL) >> 13);
+	}
+	return mesh;
+}
+
+static TestInstance makeInstance(uint64_t meshHash, uint32_t index)
+{
+	TestInstance instance;
+	instance.message.meshHash = meshHash;
+	for (int c = 0; c < 4; c++) instance.message.colour[c] = 0.25f * c + 0.01f * index;
+	instance.message.alphaTest = index % 2;
+	instance.strings.name = "Entity " + std::to_string(index);
+	instance.strings.baseTexture = index % 3 ? "models/props/texture" + std::to_string(index) : "";
+	instance.strings.normalMap = index % 4 ? "" : "models/props/normal" + std::to_string(index);
+	instance.message.nameLength = static_cast<uint32_t>(instance.strings.name.size());
+	instance.message.baseTextureLength = static_cast<uint32_t>(instance.strings.baseTexture.size());
+	instance.message.normalMapLength = static_cast<uint32_t>(instance.strings.normalMap.size());
+	return instance;
+}
+
+// Keeps what it's sent the way SceneSnapshot.cpp's sink does, meshes outlive a snapshot and instances must refer to them
+class TestSink : public SceneSink
+{
+public:
+	std::map<uint64_t, TestMesh> meshes;
+	Protocol::SnapshotMessage snapshot = {};
+	std::vector<TestInstance> instances;
+	uint32_t meshesReceived = 0;
+
+	bool beginMesh(const Protocol::MeshMessage& header, std::string name) override
+	{
+		pending = TestMesh();
+		pending.header = header;
+		pending.name = std::move(name);
+		return true;
+	}
+
+	uint8_t* getStream(uint32_t stream) override
+	{
+		if (stream >= Protocol::kStreamCount) return nullptr;
+		pending.streams[stream].resize(static_cast<size_t>(getStreamElementCount(pending.header, stream)) * Protocol::getStreamStride(stream));
+		return pending.streams[stream].data();
+	}
+
+	bool endMesh() override
+	{
+		meshesReceived++;
+		meshes[pending.header.hash] = std::move(pending);
+		return true;
+	}
+
+	bool onSnapshot(const Protocol::SnapshotMessage& message) override
+	{
+		snapshot = message;
+		instances.clear();
+		return meshes.count(message.worldHash) != 0;
+	}
+
+	bool onInstance(const Protocol::InstanceMessage& message, InstanceStrings strings) override
+	{
+		instances.push_back({ message, std::move(strings) });
+		return meshes.count(message.meshHash) != 0;
+	}
+
+private:
+	TestMesh pending;
+};
+
+static std::string channelName(const char* pTest)
+{
+	return "SceneStreamTest_" + std::to_string(getpid()) + "_" + pTest;
+}
+
+// Runs send on its own thread as the module would, while the calling thread receives into sink
+static bool roundTrip(const char* pTest, const std::function<bool(SceneChannel&)>& send, TestSink& sink, std::string& error)
+{
+	SceneChannel::UniquePtr pProducer = SceneChannel::create(channelName(pTest), kCapacity);
+	SceneChannel::UniquePtr pConsumer = pProducer ? SceneChannel::open(channelName(pTest)) : nullptr;
+	if (!pConsumer) {
+		check(false, "Channel opens");
+		return false;
+	}
+
+	bool sent = false;
+	std::thread producer([&]() { sent = send(*pProducer); });
+
+	const bool received = receiveScene(*pConsumer, sink, kTimeoutMs, error);
+
+	pConsumer->close(); // Unblocks the producer if the receiver gave up early
+	producer.join();
+	return received && sent;
+}
+
+static bool meshesMatch(const TestMesh& a, const TestMesh& b)
+{
+	bool match = a.name == b.name && std::memcmp(&a.header, &b.header, sizeof(a.header)) == 0;
+	for (uint32_t stream = 0; stream < Protocol::kStreamCount; stream++) match &= a.streams[stream] == b.streams[stream];
+	return match;
+}
+
+static bool instancesMatch(const TestInstance& a, const TestInstance& b)
+{
+	return
+		std::memcmp(&a.message, &b.message, sizeof(a.message)) == 0 &&
+		a.strings.name == b.strings.name && a.strings.baseTexture == b.strings.baseTexture && a.strings.normalMap == b.strings.normalMap;
+}
+
+/** Two snapshots over one channel, as a renderer that's sent several launches would see them.
+	The first carries a world (float streams with texture coordinates), an entity mesh without them and a quantised one, each big enough to be split into many chunks.
+	The second only refers to meshes the receiver already has, so it's sent without any vertex data.
+*/
+static void testRoundTrip()
+{
+	std::vector<TestMesh> meshes = {
+		makeMesh(0x1000, 20000, Protocol::MeshHasTexCoords, "World"),
+		makeMesh(0x2000, 7001, Protocol::MeshFlipWinding, "models/props_c17/oildrum001.mdl"),
+		makeMesh(0x3000, 12345, Protocol::MeshQuantised, "models/props_junk/wood_crate001a.mdl"),
+		makeMesh(0x4000, 0, 0, "Empty")
+	};
+
+	std::vector<TestInstance> first, second;
+	for (uint32_t i = 0; i < 50; i++) first.push_back(makeInstance(meshes[1 + i % 3].header.hash, i));
+	for (uint32_t i = 0; i < 20; i++) second.push_back(makeInstance(meshes[1 + (i + 1) % 3].header.hash, 100 + i));
+
+	Protocol::SnapshotMessage snapshot = {};
+	snapshot.worldHash = meshes[0].header.hash;
+	for (int axis = 0; axis < 3; axis++) {
+		snapshot.cameraPosition[axis] = 1.0f + axis;
+		snapshot.cameraTarget[axis] = -1.0f - axis;
+		snapshot.sunDirection[axis] = axis == 1 ? 1.0f : 0.0f;
+	}
+
+	auto sendSnapshot = [&](SceneChannel& channel, const std::vector<TestInstance>& instances) {
+		Protocol::SnapshotMessage message = snapshot;
+		message.instanceCount = static_cast<uint32_t>(instances.size());
+		if (!sendSnapshotHeader(channel, message, kTimeoutMs)) return false;
+		for (const TestInstance& instance : instances) {
+			if (!sendInstance(channel, instance.message, instance.strings, kTimeoutMs)) return false;
+		}
+		return sendEndSnapshot(channel, kTimeoutMs);
+	};
+
+	TestSink sink;
+	std::string error;
+	auto send = [&](SceneChannel& channel) {
+		if (!sendHello(channel, kTimeoutMs)) return false;
+		for (const TestMesh& mesh : meshes) {
+			if (!sendMesh(channel, mesh.getStreams(), kTimeoutMs)) return false;
+		}
+		return sendSnapshot(channel, first) && sendSnapshot(channel, second);
+	};
+
+	SceneChannel::UniquePtr pProducer = SceneChannel::create(channelName("roundtrip"), kCapacity);
+	SceneChannel::UniquePtr pConsumer = pProducer ? SceneChannel::open(channelName("roundtrip")) : nullptr;
+	check(pConsumer != nullptr, "Channel opens");
+	if (!pConsumer) return;
+	check(pProducer->getMaxPayloadSize() < 20000 * 12, "Meshes are bigger than a chunk");
+
+	bool sent = false;
+	std::thread producer([&]() { sent = send(*pProducer); });
+
+	const bool receivedFirst = receiveScene(*pConsumer, sink, kTimeoutMs, error);
+	bool firstMatched = sink.instances.size() == first.size();
+	for (size_t i = 0; firstMatched && i < first.size(); i++) firstMatched &= instancesMatch(sink.instances[i], first[i]);
+	const uint32_t meshesAfterFirst = sink.meshesReceived;
+
+	const bool receivedSecond = receivedFirst && receiveScene(*pConsumer, sink, kTimeoutMs, error);
+	pConsumer->close();
+	producer.join();
+
+	check(sent && receivedFirst && receivedSecond, "Both snapshots are sent and received");
+	if (!error.empty()) std::fprintf(stderr, "%s\n", error.c_str());
+
+	check(meshesAfterFirst == meshes.size() && sink.meshesReceived == meshes.size(), "Every mesh arrives once, with the first snapshot");
+	bool meshesIdentical = sink.meshes.size() == meshes.size();
+	for (const TestMesh& mesh : meshes) meshesIdentical &= sink.meshes.count(mesh.header.hash) && meshesMatch(sink.meshes[mesh.header.hash], mesh);
+	check(meshesIdentical, "Meshes arrive byte for byte, with their names, flags and quantisation blocks");
+
+	check(firstMatched, "The first snapshot's instances arrive in order with their colours and strings");
+	bool secondMatched = sink.instances.size() == second.size();
+	for (size_t i = 0; secondMatched && i < second.size(); i++) secondMatched &= instancesMatch(sink.instances[i], second[i]);
+	check(secondMatched, "The second snapshot's instances refer to meshes sent with the first");
+	check(std::memcmp(&sink.snapshot.cameraPosition, &snapshot.cameraPosition, sizeof(float) * 9) == 0 && sink.snapshot.worldHash == snapshot.worldHash, "Camera and sun arrive");
+}
+
+// Writes a hand made record, so the receiver's checks can be hit with things the send functions never produce
+template<typename T>
+static bool writeRaw(SceneChannel& channel, uint32_t type, const T& message, uint64_t extraBytes = 0)
+{
+	uint8_t* pPayload = channel.beginWrite(type, sizeof(T) + extraBytes, kTimeoutMs);
+	if (!pPayload) return false;
+	std::memset(pPayload, 0, sizeof(T) + extraBytes);
+	std::memcpy(pPayload, &message, sizeof(T));
+	channel.endWrite();
+	return true;
+}
+
+static void expectRejected(const char* pTest, const std::function<bool(SceneChannel&)>& send, const char* pWhat)
+{
+	TestSink sink;
+	std::string error;
+	check(!roundTrip(pTest, send, sink, error), pWhat);
+	check(!error.empty(), "Rejections say why");
+}
+
+static void testRejections()
+{
+	const TestMesh mesh = makeMesh(0x5000, 1000, 0, "Mesh");
+
+	expectRejected("version", [](SceneChannel& channel) {
+		const Protocol::HelloMessage hello = { Protocol::kVersion + 1, 0 };
+		return writeRaw(channel, Protocol::Hello, hello);
+	}, "A protocol version mismatch is rejected");
+
+	expectRejected("shutdown", [&](SceneChannel& channel) {
+		return sendHello(channel, kTimeoutMs) && sendMesh(channel, mesh.getStreams(), kTimeoutMs) && channel.write(Protocol::Shutdown, nullptr, 0, kTimeoutMs);
+	}, "Shutting down mid snapshot fails the receive");
+
+	expectRejected("overrun", [&](SceneChannel& channel) {
+		Protocol::MeshMessage header = mesh.header;
+		header.nameLength = 0;
+		const Protocol::MeshChunkMessage chunk = { mesh.header.hash, Protocol::StreamPositions, 990, 20, 0 };
+		return writeRaw(channel, Protocol::Mesh, header) && writeRaw(channel, Protocol::MeshChunk, chunk, 20 * 12);
+	}, "A chunk past the end of its mesh is rejected");
+
+	expectRejected("short", [&](SceneChannel& channel) {
+		Protocol::MeshMessage header = mesh.header;
+		header.nameLength = 0;
+		const Protocol::MeshChunkMessage chunk = { mesh.header.hash, Protocol::StreamPositions, 0, 100, 0 };
+		return writeRaw(channel, Protocol::Mesh, header) && writeRaw(channel, Protocol::MeshChunk, chunk, 99 * 12);
+	}, "A chunk with fewer bytes than it claims is rejected");
+
+	expectRejected("stream", [&](SceneChannel& channel) {
+		Protocol::MeshMessage header = mesh.header;
+		header.nameLength = 0;
+		const Protocol::MeshChunkMessage chunk = { mesh.header.hash, Protocol::StreamTexCoords, 0, 10, 0 };
+		return writeRaw(channel, Protocol::Mesh, header) && writeRaw(channel, Protocol::MeshChunk, chunk, 10 * 8);
+	}, "A chunk for a stream the mesh doesn't have is rejected");
+
+	expectRejected("name", [&](SceneChannel& channel) {
+		Protocol::MeshMessage header = mesh.header;
+		header.nameLength = 1000; // No name bytes follow
+		return writeRaw(channel, Protocol::Mesh, header);
+	}, "A string running past its message is rejected");
+
+	expectRejected("unknown", [&](SceneChannel& channel) {
+		Protocol::SnapshotMessage snapshot = {};
+		snapshot.worldHash = 0x6000;
+		return writeRaw(channel, Protocol::Snapshot, snapshot);
+	}, "A snapshot of a world that was never sent is rejected");
+
+	expectRejected("count", [&](SceneChannel& channel) {
+		Protocol::SnapshotMessage snapshot = {};
+		snapshot.worldHash = mesh.header.hash;
+		snapshot.instanceCount = 2;
+		return
+			sendMesh(channel, mesh.getStreams(), kTimeoutMs) && sendSnapshotHeader(channel, snapshot, kTimeoutMs) &&
+			sendInstance(channel, makeInstance(mesh.header.hash, 0).message, {}, kTimeoutMs) && sendEndSnapshot(channel, kTimeoutMs);
+	}, "A snapshot missing instances is rejected");
+}
+
+int main()
+{
+	testRoundTrip();
+	testRejections();
+
+	return finishChecks("scene stream");
+}
@@ -0,0 +1,136 @@
+/*
+	Checks the texture streaming policy (TextureBudget.h) and the decoded image cache (LruCache in SceneCache.h)
+*/
+#include "Check.h"
+#include "SceneCache.h"
+#include "TextureBudget.h"
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using namespace GModDXR;
+
+// Square texture with an 8 mip chain (128 at mip 3 is the start mip, as kStartDim would give)
+static TextureBudgetEntry makeEntry(uint32_t size, uint64_t lastRequestFrame)
+{
+	TextureBudgetEntry e;
+	e.width = size;
+	e.height = size;
+	e.startMip = 3;
+	e.residentMip = e.startMip;
+	e.desiredMip = e.startMip;
+	e.lastRequestFrame = lastRequestFrame;
+	return e;
+}
+
+static void testMipChainBytes()
+{
+	check(mipChainBytes(1, 1, 4, 0) == 4, "1x1 chain is a single texel");
+	check(mipChainBytes(4, 4, 4, 0) == (16 + 4 + 1) * 4, "4x4 chain sums every level");
+	check(mipChainBytes(4, 4, 4, 1) == (4 + 1) * 4, "Chain starts at the first mip");
+	check(mipChainBytes(8, 2, 4, 0) == (16 + 4 + 2 + 1) * 4, "Non square chain clamps each side to 1");
+}
+
+static void testRequests()
+{
+	std::vector<TextureBudgetEntry> entries = { makeEntry(1024, 0), makeEntry(1024, 0), makeEntry(1024, 0) };
+	entries[2].desiredMip = 0;
+
+	// Requests coarser than the start mip are floored to it, unrequested textures keep their desired mip until they age out
+	applyMipRequests(entries, { 1, 6, UINT32_MAX }, 10, 120);
+	check(entries[0].desiredMip == 1 && entries[0].lastRequestFrame == 10, "Requested mip is desired");
+	check(entries[1].desiredMip == 3, "Desired mip never coarser than the start mip");
+	check(entries[2].desiredMip == 0 && entries[2].lastRequestFrame == 0, "Unrequested texture keeps its mip");
+
+	applyMipRequests(entries, { UINT32_MAX, UINT32_MAX, UINT32_MAX }, 130, 120);
+	check(entries[0].desiredMip == 1, "Texture isn't evicted before evictAfterFrames");
+	check(entries[2].desiredMip == 3, "Texture falls back to its start mip after evictAfterFrames");
+}
+
+static void testBudget()
+{
+	const uint64_t full = mipChainBytes(1024, 1024, 4, 0);
+	const uint64_t start = mipChainBytes(1024, 1024, 4, 3);
+
+	// Everything fits
+	std::vector<TextureBudgetEntry> entries = { makeEntry(1024, 5), makeEntry(1024, 7) };
+	for (auto& e : entries) e.desiredMip = 0;
+	check(fitTexturesToBudget(entries, 2 * full) == 2 * full, "Budget large enough for every desired mip");
+	check(entries[0].targetMip == 0 && entries[1].targetMip == 0, "Targets are the desired mips when they fit");
+
+	// Dropping a single mip is enough, the least recently requested texture gives way
+	uint64_t total = fitTexturesToBudget(entries, full + mipChainBytes(1024, 1024, 4, 1));
+	check(total <= full + mipChainBytes(1024, 1024, 4, 1), "Targets fit the budget");
+	check(entries[0].targetMip == 1 && entries[1].targetMip == 0, "Least recently requested texture drops first");
+
+	// The stale texture goes all the way down to its start mip before the recently requested one loses any
+	total = fitTexturesToBudget(entries, full + start);
+	check(total <= full + start, "Targets fit a tight budget");
+	check(entries[0].targetMip == 3 && entries[1].targetMip == 0, "Recently requested texture keeps its mips while a stale one gives them up");
+
+	// Only once the stale texture has nothing left to give does the recent one drop
+	total = fitTexturesToBudget(entries, mipChainBytes(1024, 1024, 4, 1) + start);
+	check(total <= mipChainBytes(1024, 1024, 4, 1) + start, "Targets fit a tighter budget");
+	check(entries[0].targetMip == 3 && entries[1].targetMip == 1, "Recent texture drops only what the stale one couldn't cover");
+
+	// In use textures keep their mips however many stale ones there are, rather than every texture losing a mip per round
+	entries = { makeEntry(1024, 1), makeEntry(1024, 2), makeEntry(1024, 3), makeEntry(1024, 100) };
+	for (auto& e : entries) e.desiredMip = 0;
+	fitTexturesToBudget(entries, 3 * start + full);
+	check(entries[0].targetMip == 3 && entries[1].targetMip == 3 && entries[2].targetMip == 3, "Stale textures are taken to their start mips");
+	check(entries[3].targetMip == 0, "The texture in use keeps its full chain");
+
+	// Equally recent textures drop the largest first
+	entries = { makeEntry(512, 5), makeEntry(1024, 5) };
+	for (auto& e : entries) e.desiredMip = 0;
+	fitTexturesToBudget(entries, mipChainBytes(512, 512, 4, 0) + mipChainBytes(1024, 1024, 4, 1));
+	check(entries[0].targetMip == 0 && entries[1].targetMip == 1, "Largest texture drops first on a tie");
+
+	// Start mips are never evicted, even over budget
+	total = fitTexturesToBudget(entries, 0);
+	check(entries[0].targetMip == 3 && entries[1].targetMip == 3, "Targets stop at the start mip");
+	check(total == mipChainBytes(512, 512, 4, 3) + start, "Over budget total is the start set");
+
+	// Textures without a resident mip aren't part of the budget
+	entries = { makeEntry(1024, 5), makeEntry(1024, 5) };
+	entries[1].residentMip = UINT32_MAX;
+	entries[0].desiredMip = entries[1].desiredMip = 0;
+	check(fitTexturesToBudget(entries, full) == full, "Unloaded textures are skipped");
+	check(entries[1].targetMip == UINT32_MAX, "Unloaded texture has no target");
+}
+
+static void testLruCache()
+{
+	LruCache<std::string> cache(100);
+	cache.insert(1, std::make_shared<std::string>("a"), 40);
+	cache.insert(2, std::make_shared<std::string>("b"), 40);
+	check(cache.getBytes() == 80, "Bytes of every entry are counted");
+
+	// Using 1 makes 2 the least recently used, so it's the one evicted
+	auto pHeld = cache.find(2);
+	check(cache.find(1) && *cache.find(1) == "a", "Inserted value is found");
+	cache.insert(3, std::make_shared<std::string>("c"), 40);
+	check(!cache.find(2), "Least recently used entry is evicted");
+	check(cache.find(1) && cache.find(3), "Recently used entries are kept");
+	check(cache.getBytes() == 80, "Evicted bytes are released");
+	check(pHeld && *pHeld == "b", "Evicted value stays valid while held");
+
+	// Replacing a value doesn't count it twice
+	cache.insert(3, std::make_shared<std::string>("d"), 20);
+	check(cache.getBytes() == 60 && *cache.find(3) == "d", "Reinserted value replaces the old one");
+
+	// A value over the budget is kept on its own
+	cache.insert(4, std::make_shared<std::string>("e"), 500);
+	check(cache.find(4) && !cache.find(1) && !cache.find(3), "Oversized value evicts everything else");
+	check(cache.getBytes() == 500, "Oversized value is counted");
+}
+
+int main()
+{
+	testMipChainBytes();
+	testRequests();
+	testBudget();
+	testLruCache();
+
+	return finishChecks("streaming");
+}
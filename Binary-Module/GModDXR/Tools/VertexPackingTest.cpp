@@ -0,0 +1,165 @@
+/*
+	Round trips positions and normals through the compact vertex encodings (VertexPacking.h) and checks the documented error bounds
+*/
+#include "Check.h"
+#include "VertexPacking.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <random>
+#include <vector>
+
+using namespace GModDXR;
+
+static const int kSamples = 1000000;
+static const double kPi = 3.14159265358979323846;
+
+// Positions anywhere within the mesh bounds come back within half a quantisation step (plus float rounding)
+static void testPositions(std::mt19937& rng)
+{
+	std::uniform_real_distribution<float> origin(-16384.f, 16384.f);
+	std::uniform_real_distribution<float> logExtent(-2.f, 4.5f);
+	std::uniform_real_distribution<float> unit(0.f, 1.f);
+
+	double worstSteps = 0.0;
+	for (int i = 0; i < kSamples; i++) {
+		const float boundsMin = origin(rng);
+		const float extent = std::pow(10.f, logExtent(rng));
+
+		// Include the bounds themselves, where clamping and rounding meet
+		const float t = i % 100 == 0 ? 0.f : i % 100 == 1 ? 1.f : unit(rng);
+		const float position = boundsMin + t * extent;
+
+		const float decoded = boundsMin + unorm16ToFloat(floatToUnorm16((position - boundsMin) / extent)) * extent;
+		const double step = extent / 65535.0;
+		const double rounding = 4.0 * std::numeric_limits<float>::epsilon() * (std::abs(boundsMin) + extent);
+		const double error = std::abs(static_cast<double>(decoded) - position);
+		check(error <= 0.5 * step + rounding, "Position error is at most half of extent / 65535");
+		worstSteps = std::max(worstSteps, (error - rounding) / step);
+	}
+	std::printf("Positions: worst error %.3f quantisation steps\n", std::max(worstSteps, 0.0));
+
+	// Positions outside the bounds (which create never produces) clamp to them
+	check(floatToUnorm16(-0.5f) == 0 && floatToUnorm16(1.5f) == 65535, "Positions clamp to the bounds");
+}
+
+// A map sized triangle soup of small triangles, quantised per block after spatial ordering, keeps far more precision than
+// quantising against the whole map (half of 32768 / 65535, so a quarter of a unit)
+static void testBlocks(std::mt19937& rng)
+{
+	const size_t triangleCount = 200000;
+	const float mapExtent = 32768.f;
+	std::uniform_real_distribution<float> ground(-mapExtent / 2.f, mapExtent / 2.f);
+	std::uniform_real_distribution<float> height(-512.f, 512.f);
+	std::uniform_real_distribution<float> corner(-32.f, 32.f);
+
+	std::vector<float> positions(triangleCount * 9);
+	for (size_t t = 0; t < triangleCount; t++) {
+		const float centre[3] = { ground(rng), ground(rng), height(rng) };
+		for (size_t i = 0; i < 9; i++) positions[t * 9 + i] = centre[i % 3] + corner(rng);
+	}
+
+	const std::vector<uint32_t> order = getSpatialTriangleOrder(positions.data(), positions.size() / 3);
+	check(order.size() == triangleCount, "Spatial order covers every triangle");
+	std::vector<bool> seen(triangleCount, false);
+	for (uint32_t t : order) seen[t] = true;
+	check(std::find(seen.begin(), seen.end(), false) == seen.end(), "Spatial order is a permutation");
+
+	std::vector<float> ordered(positions.size());
+	for (size_t t = 0; t < triangleCount; t++) std::copy_n(&positions[order[t] * 9], 9, &ordered[t * 9]);
+
+	const size_t vertexCount = triangleCount * 3;
+	std::vector<PackedVertex> packed(vertexCount);
+	std::vector<PackedBlock> blocks(getPackedBlockCount(vertexCount));
+	for (size_t b = 0; b < blocks.size(); b++) {
+		const size_t first = b * kPackedBlockVertices;
+		packPositionBlock(&ordered[first * 3], std::min<size_t>(kPackedBlockVertices, vertexCount - first), &packed[first], blocks[b]);
+	}
+
+	double worst = 0.0;
+	for (size_t i = 0; i < vertexCount; i++) {
+		const PackedBlock& block = blocks[i / kPackedBlockVertices];
+		float decoded[3];
+		unpackPosition(packed[i], block, decoded);
+		for (int axis = 0; axis < 3; axis++) {
+			const double error = std::abs(static_cast<double>(decoded[axis]) - ordered[i * 3 + axis]);
+			const double rounding = 4.0 * std::numeric_limits<float>::epsilon() * (std::abs(block.boundsMin[axis]) + block.boundsExtent[axis]);
+			check(error <= 0.5 * block.boundsExtent[axis] / 65535.0 + rounding, "Block position error is at most half of the block's extent / 65535");
+			worst = std::max(worst, error);
+		}
+	}
+
+	const double mapBound = 0.5 * mapExtent / 65535.0;
+	std::printf("Blocks: %zu blocks, worst error %.5f units (quantising against the map: up to %.5f)\n", blocks.size(), worst, mapBound);
+	check(worst < mapBound / 8.0, "Block quantisation is at least 8x as precise as quantising against the map");
+}
+
+// atan2 of the cross and dot products, acos loses too much precision for angles this small
+static double angleDegrees(const float a[3], const float b[3])
+{
+	const double cross[3] = {
+		static_cast<double>(a[1]) * b[2] - static_cast<double>(a[2]) * b[1],
+		static_cast<double>(a[2]) * b[0] - static_cast<double>(a[0]) * b[2],
+		static_cast<double>(a[0]) * b[1] - static_cast<double>(a[1]) * b[0]
+	};
+	const double dot = static_cast<double>(a[0]) * b[0] + static_cast<double>(a[1]) * b[1] + static_cast<double>(a[2]) * b[2];
+	return std::atan2(std::sqrt(cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2]), dot) * 180.0 / kPi;
+}
+
+static double roundTripNormal(const float normal[3])
+{
+	float u, v;
+	encodeOctahedral(normal[0], normal[1], normal[2], u, v);
+
+	float decoded[3];
+	decodeOctahedral(snorm16ToFloat(floatToSnorm16(u)), snorm16ToFloat(floatToSnorm16(v)), decoded[0], decoded[1], decoded[2]);
+
+	const double length = std::sqrt(decoded[0] * decoded[0] + decoded[1] * decoded[1] + decoded[2] * decoded[2]);
+	check(std::abs(length - 1.0) < 1e-5, "Decoded normals are unit length");
+	return angleDegrees(normal, decoded);
+}
+
+// Unit normals come back within 0.01 degrees, including the axes and the folded edges of the lower hemisphere
+static void testNormals(std::mt19937& rng)
+{
+	std::normal_distribution<float> gaussian;
+
+	double worst = 0.0;
+	for (int i = 0; i < kSamples; i++) {
+		float normal[3] = { gaussian(rng), gaussian(rng), gaussian(rng) };
+		if (i % 4 == 0) normal[i / 4 % 3] = 0.f; // On the octahedron's edges
+		const float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+		if (length == 0.f) continue;
+		for (float& c : normal) c /= length;
+
+		worst = std::max(worst, roundTripNormal(normal));
+	}
+
+	for (int axis = 0; axis < 3; axis++) {
+		for (float sign : { 1.f, -1.f }) {
+			float normal[3] = { 0.f, 0.f, 0.f };
+			normal[axis] = sign;
+			worst = std::max(worst, roundTripNormal(normal));
+		}
+	}
+
+	std::printf("Normals: worst error %.5f degrees\n", worst);
+	check(worst < 0.01, "Normal error is under 0.01 degrees");
+
+	// A zero normal (degenerate capture) still decodes to a unit vector rather than NaNs
+	float u, v, x, y, z;
+	encodeOctahedral(0.f, 0.f, 0.f, u, v);
+	decodeOctahedral(u, v, x, y, z);
+	check(x == 0.f && y == 0.f && z == 1.f, "Zero normal decodes to +Z");
+}
+
+int main()
+{
+	std::mt19937 rng(1234);
+	testPositions(rng);
+	testBlocks(rng);
+	testNormals(rng);
+
+	return finishChecks("vertex packing");
+}
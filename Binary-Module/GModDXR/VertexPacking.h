@@ -0,0 +1,174 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace GModDXR
+{
+	/*
+		Compact CPU side vertex layout for captured geometry, 14 bytes against 32 for full precision
+		- Positions are 16 bit unorm relative to the bounds of their block of kPackedBlockVertices vertices (error at most half of
+		  the block's extent / 65535 per axis), triangles are spatially grouped first so a block covers a small part of the mesh
+		- Normals are octahedral encoded as two 16 bit snorms (error well under 0.01 degrees)
+		- UVs are half precision (relative error of 2^-11, so about 1/2048 of a texture at a UV of 1)
+
+		This only shrinks the CPU side copies (the captured meshes, the relaunch caches and what's sent to the out of process renderer)
+		Falcor's scene builder takes float vertices, so the GPU vertex buffers and BLASes are built from the decoded values and are the same size either way
+
+		Doesn't depend on Falcor so the error bounds can be checked on their own (see Tools/VertexPackingTest.cpp)
+	*/
+	struct PackedVertex
+	{
+		uint16_t position[3];
+		uint16_t normal[2];
+		uint16_t texCoord[2];
+	};
+
+	static const uint32_t kPackedBlockVertices = 768; // 256 triangles, so a triangle never spans two blocks
+
+	// Bounds the positions of a block are quantised against
+	struct PackedBlock
+	{
+		float boundsMin[3];
+		float boundsExtent[3];
+	};
+
+	inline size_t getPackedBlockCount(size_t vertexCount)
+	{
+		return (vertexCount + kPackedBlockVertices - 1) / kPackedBlockVertices;
+	}
+
+	inline uint16_t floatToUnorm16(float val)
+	{
+		return static_cast<uint16_t>(std::round(std::clamp(val, 0.f, 1.f) * 65535.f));
+	}
+
+	inline float unorm16ToFloat(uint16_t val)
+	{
+		return static_cast<float>(val) / 65535.f;
+	}
+
+	inline uint16_t floatToSnorm16(float val)
+	{
+		const int16_t snorm = static_cast<int16_t>(std::round(std::clamp(val, -1.f, 1.f) * 32767.f));
+		return static_cast<uint16_t>(snorm);
+	}
+
+	inline float snorm16ToFloat(uint16_t val)
+	{
+		return std::max(static_cast<float>(static_cast<int16_t>(val)) / 32767.f, -1.f);
+	}
+
+	inline void encodeOctahedral(float x, float y, float z, float& u, float& v)
+	{
+		// Project onto the octahedron, then fold the lower hemisphere over the upper one
+		const float l1 = std::abs(x) + std::abs(y) + std::abs(z);
+		if (l1 == 0.f) {
+			u = v = 0.f;
+			return;
+		}
+
+		u = x / l1;
+		v = y / l1;
+		if (z < 0.f) {
+			const float pu = u;
+			u = (1.f - std::abs(v)) * (pu >= 0.f ? 1.f : -1.f);
+			v = (1.f - std::abs(pu)) * (v >= 0.f ? 1.f : -1.f);
+		}
+	}
+
+	// Returns a unit vector
+	inline void decodeOctahedral(float u, float v, float& x, float& y, float& z)
+	{
+		x = u;
+		y = v;
+		z = 1.f - std::abs(u) - std::abs(v);
+		if (z < 0.f) {
+			x = (1.f - std::abs(v)) * (u >= 0.f ? 1.f : -1.f);
+			y = (1.f - std::abs(u)) * (v >= 0.f ? 1.f : -1.f);
+		}
+
+		const float invLength = 1.f / std::sqrt(x * x + y * y + z * z);
+		x *= invLength;
+		y *= invLength;
+		z *= invLength;
+	}
+
+	/** Orders a triangle soup's triangles so each block of kPackedBlockVertices vertices covers a small part of the mesh, by
+		splitting the centroids at the median of their longest axis (rounded to whole blocks) until each side fits a block.
+		\param[in] pPositions vertexCount xyz triples, every 3 vertices a triangle.
+		\return Index of the triangle to put at each position.
+	*/
+	inline std::vector<uint32_t> getSpatialTriangleOrder(const float* pPositions, size_t vertexCount)
+	{
+		const size_t triangleCount = vertexCount / 3;
+		const size_t blockTriangles = kPackedBlockVertices / 3;
+
+		std::vector<float> centroids(triangleCount * 3);
+		for (size_t t = 0; t < triangleCount; t++) {
+			for (int axis = 0; axis < 3; axis++) centroids[t * 3 + axis] = pPositions[t * 9 + axis] + pPositions[t * 9 + 3 + axis] + pPositions[t * 9 + 6 + axis];
+		}
+
+		std::vector<uint32_t> order(triangleCount);
+		for (size_t t = 0; t < triangleCount; t++) order[t] = static_cast<uint32_t>(t);
+
+		// Ranges always start on a block boundary, so every block ends up inside one leaf
+		std::vector<std::pair<size_t, size_t>> ranges = { { 0, triangleCount } };
+		while (!ranges.empty()) {
+			const auto [first, last] = ranges.back();
+			ranges.pop_back();
+			if (last - first <= blockTriangles) continue;
+
+			float boundsMin[3] = { INFINITY, INFINITY, INFINITY };
+			float boundsMax[3] = { -INFINITY, -INFINITY, -INFINITY };
+			for (size_t i = first; i < last; i++) {
+				for (int axis = 0; axis < 3; axis++) {
+					boundsMin[axis] = std::min(boundsMin[axis], centroids[order[i] * 3 + axis]);
+					boundsMax[axis] = std::max(boundsMax[axis], centroids[order[i] * 3 + axis]);
+				}
+			}
+			int splitAxis = 0;
+			for (int axis = 1; axis < 3; axis++) {
+				if (boundsMax[axis] - boundsMin[axis] > boundsMax[splitAxis] - boundsMin[splitAxis]) splitAxis = axis;
+			}
+
+			const size_t blockCount = (last - first + blockTriangles - 1) / blockTriangles;
+			const size_t middle = first + blockCount / 2 * blockTriangles;
+			std::nth_element(order.begin() + first, order.begin() + middle, order.begin() + last, [&](uint32_t a, uint32_t b) {
+				return centroids[a * 3 + splitAxis] < centroids[b * 3 + splitAxis];
+			});
+			ranges.push_back({ first, middle });
+			ranges.push_back({ middle, last });
+		}
+		return order;
+	}
+
+	// Quantises count positions (xyz triples) against their own bounds, which are written to block
+	inline void packPositionBlock(const float* pPositions, size_t count, PackedVertex* pPacked, PackedBlock& block)
+	{
+		float boundsMax[3];
+		for (int axis = 0; axis < 3; axis++) {
+			block.boundsMin[axis] = count ? INFINITY : 0.f;
+			boundsMax[axis] = count ? -INFINITY : 0.f;
+		}
+		for (size_t i = 0; i < count; i++) {
+			for (int axis = 0; axis < 3; axis++) {
+				block.boundsMin[axis] = std::min(block.boundsMin[axis], pPositions[i * 3 + axis]);
+				boundsMax[axis] = std::max(boundsMax[axis], pPositions[i * 3 + axis]);
+			}
+		}
+
+		for (int axis = 0; axis < 3; axis++) {
+			block.boundsExtent[axis] = boundsMax[axis] - block.boundsMin[axis];
+			const float invExtent = 1.f / std::max(block.boundsExtent[axis], 1e-20f);
+			for (size_t i = 0; i < count; i++) pPacked[i].position[axis] = floatToUnorm16((pPositions[i * 3 + axis] - block.boundsMin[axis]) * invExtent);
+		}
+	}
+
+	inline void unpackPosition(const PackedVertex& v, const PackedBlock& block, float* pOut)
+	{
+		for (int axis = 0; axis < 3; axis++) pOut[axis] = block.boundsMin[axis] + unorm16ToFloat(v.position[axis]) * block.boundsExtent[axis];
+	}
+}
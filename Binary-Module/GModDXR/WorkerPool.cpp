@@ -0,0 +1,54 @@
+#include "WorkerPool.h"
+#include <algorithm>
+
+namespace GModDXR
+{
+	WorkerPool::WorkerPool(uint32_t workerCount)
+	{
+		for (uint32_t i = 0; i < std::max(workerCount, 1U); i++) workers.emplace_back(&WorkerPool::workerLoop, this);
+	}
+
+	WorkerPool::~WorkerPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			stopping = true;
+		}
+		queueCondition.notify_all();
+		for (auto& worker : workers) worker.join();
+	}
+
+	void WorkerPool::enqueue(std::function<void()> job)
+	{
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			queue.push_back(std::move(job));
+		}
+		queueCondition.notify_one();
+	}
+
+	size_t WorkerPool::getPendingCount()
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		return queue.size() + running;
+	}
+
+	void WorkerPool::workerLoop()
+	{
+		while (true) {
+			std::function<void()> job;
+			{
+				std::unique_lock<std::mutex> lock(queueMutex);
+				queueCondition.wait(lock, [this]() { return stopping || !queue.empty(); });
+				if (queue.empty()) return; // Only empty once stopping, since the queue is drained first
+
+				job = std::move(queue.front());
+				queue.pop_front();
+				running++;
+			}
+
+			job();
+			running--;
+		}
+	}
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace GModDXR
+{
+	/*
+		Threads that run queued jobs in the order they were queued (several can be running at once)
+
+		Doesn't depend on Falcor so it can be checked on its own (see Tools/FrameWriterTest.cpp)
+	*/
+	class WorkerPool
+	{
+	public:
+		explicit WorkerPool(uint32_t workerCount);
+		~WorkerPool(); // Runs everything queued before returning
+
+		void enqueue(std::function<void()> job);
+
+		// Jobs queued or still running
+		size_t getPendingCount();
+
+	private:
+		std::vector<std::thread> workers;
+		std::deque<std::function<void()>> queue;
+		std::mutex queueMutex;
+		std::condition_variable queueCondition;
+		bool stopping = false;
+		std::atomic<size_t> running = 0;
+
+		void workerLoop();
+	};
+}
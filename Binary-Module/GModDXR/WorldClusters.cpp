@@ -0,0 +1,270 @@
+#include "WorldClusters.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+namespace GModDXR
+{
+	using namespace Falcor;
+
+	static const float kRootHalfSize = 32768.f;         // Twice Source's coordinate limit, so every map fits
+	static const uint32_t kMaxClusterTriangles = 32768; // Nodes with more triangles than this are split
+	static const float kMinNodeSize = 256.f;            // Nodes this small are never split, however dense
+
+	struct ClusterVertex
+	{
+		float3 position;
+		float3 normal;
+		float2 texCoord;
+	};
+
+	// Triangles in a node, whole world triangles by index and pieces of ones that were clipped at a split plane (three vertices each)
+	struct NodeTriangles
+	{
+		std::vector<uint32_t> whole;
+		std::vector<ClusterVertex> pieces;
+
+		size_t size() const { return whole.size() + pieces.size() / 3; }
+	};
+
+	struct OctreeLeaf
+	{
+		std::string name;
+		NodeTriangles triangles;
+	};
+
+	// Which side of a split plane some geometry is on, from its extent along the plane's axis
+	enum class PlaneSide { Below, Above, Both };
+
+	static PlaneSide classify(float extentMin, float extentMax, float plane)
+	{
+		if (extentMin >= plane) return PlaneSide::Above;
+		if (extentMax <= plane) return PlaneSide::Below;
+		return PlaneSide::Both;
+	}
+
+	static ClusterVertex lerpVertex(const ClusterVertex& a, const ClusterVertex& b, float t)
+	{
+		return { glm::mix(a.position, b.position, t), glm::normalize(glm::mix(a.normal, b.normal, t)), glm::mix(a.texCoord, b.texCoord, t) };
+	}
+
+	// Sutherland-Hodgman against one side of an axis aligned plane (above keeps >= plane, below keeps <= plane)
+	static void clipToSide(const std::vector<ClusterVertex>& polygon, int axis, float plane, bool above, std::vector<ClusterVertex>& out)
+	{
+		out.clear();
+		const float sign = above ? 1.f : -1.f;
+		for (size_t i = 0; i < polygon.size(); i++) {
+			const ClusterVertex& a = polygon[i];
+			const ClusterVertex& b = polygon[(i + 1) % polygon.size()];
+			const float da = (a.position[axis] - plane) * sign;
+			const float db = (b.position[axis] - plane) * sign;
+			if (da >= 0.f) out.push_back(a);
+			if ((da > 0.f && db < 0.f) || (da < 0.f && db > 0.f)) {
+				out.push_back(lerpVertex(a, b, da / (da - db)));
+				out.back().position[axis] = plane; // Exactly on the plane, so the piece never pokes into the neighbouring cell
+			}
+		}
+	}
+
+	// Cuts a convex polygon into the octants around centre, fan triangulating each piece into its child
+	static void clipToChildren(const std::vector<ClusterVertex>& polygon, float3 centre, int axis, uint32_t child, std::array<NodeTriangles, 8>& children)
+	{
+		if (polygon.size() < 3) return;
+		if (axis == 3) {
+			for (size_t i = 1; i + 1 < polygon.size(); i++) {
+				children[child].pieces.insert(children[child].pieces.end(), { polygon[0], polygon[i], polygon[i + 1] });
+			}
+			return;
+		}
+
+		float extentMin = polygon[0].position[axis], extentMax = extentMin;
+		for (const ClusterVertex& vertex : polygon) {
+			extentMin = std::min(extentMin, vertex.position[axis]);
+			extentMax = std::max(extentMax, vertex.position[axis]);
+		}
+
+		// Only cut along planes the polygon actually crosses, one lying in a plane would otherwise end up on both sides
+		const PlaneSide side = classify(extentMin, extentMax, centre[axis]);
+		if (side != PlaneSide::Both) {
+			clipToChildren(polygon, centre, axis + 1, side == PlaneSide::Above ? child | (1u << axis) : child, children);
+			return;
+		}
+
+		std::vector<ClusterVertex> piece;
+		clipToSide(polygon, axis, centre[axis], false, piece);
+		clipToChildren(piece, centre, axis + 1, child, children);
+		clipToSide(polygon, axis, centre[axis], true, piece);
+		clipToChildren(piece, centre, axis + 1, child | (1u << axis), children);
+	}
+
+	// Octant a triangle is entirely inside, or 8 if it crosses one of the split planes
+	static uint32_t findChild(const float3& p0, const float3& p1, const float3& p2, float3 centre)
+	{
+		const float3 triangleMin = glm::min(p0, glm::min(p1, p2));
+		const float3 triangleMax = glm::max(p0, glm::max(p1, p2));
+		uint32_t child = 0;
+		for (int axis = 0; axis < 3; axis++) {
+			const PlaneSide side = classify(triangleMin[axis], triangleMax[axis], centre[axis]);
+			if (side == PlaneSide::Both) return 8;
+			if (side == PlaneSide::Above) child |= 1u << axis;
+		}
+		return child;
+	}
+
+	static void splitNode(
+		const MeshData& world, float3 nodeMin, float nodeSize, uint32_t depth,
+		NodeTriangles triangles, std::vector<OctreeLeaf>& leaves, uint32_t& clippedTriangles
+	) {
+		if (triangles.size() <= kMaxClusterTriangles || nodeSize * 0.5f < kMinNodeSize) {
+			// Named by cell so a cluster keeps its name across launches
+			const int3 cell = int3(glm::floor((nodeMin + kRootHalfSize) / nodeSize));
+			leaves.push_back({ "World_" + std::to_string(depth) + "_" + std::to_string(cell.x) + "_" + std::to_string(cell.y) + "_" + std::to_string(cell.z), std::move(triangles) });
+			return;
+		}
+
+		// Triangles inside one octant move to that child as they are, ones crossing a split plane are clipped into a piece per child
+		// (assigning them whole, by centroid, would stretch the child's bounds over its neighbours and make their BLASes overlap)
+		const float childSize = nodeSize * 0.5f;
+		const float3 centre = nodeMin + childSize;
+		std::array<NodeTriangles, 8> children;
+		std::vector<ClusterVertex> polygon;
+		for (uint32_t triangle : triangles.whole) {
+			const float3 p0 = world.getPosition(triangle * 3), p1 = world.getPosition(triangle * 3 + 1), p2 = world.getPosition(triangle * 3 + 2);
+			const uint32_t child = findChild(p0, p1, p2, centre);
+			if (child < 8) {
+				children[child].whole.push_back(triangle);
+				continue;
+			}
+
+			polygon.clear();
+			for (uint32_t v = triangle * 3; v < triangle * 3 + 3; v++) polygon.push_back({ world.getPosition(v), world.getNormal(v), world.getTexCoord(v) });
+			clipToChildren(polygon, centre, 0, 0, children);
+			clippedTriangles++;
+		}
+		for (size_t i = 0; i < triangles.pieces.size(); i += 3) {
+			const uint32_t child = findChild(triangles.pieces[i].position, triangles.pieces[i + 1].position, triangles.pieces[i + 2].position, centre);
+			if (child < 8) {
+				children[child].pieces.insert(children[child].pieces.end(), triangles.pieces.begin() + i, triangles.pieces.begin() + i + 3);
+				continue;
+			}
+
+			polygon.assign(triangles.pieces.begin() + i, triangles.pieces.begin() + i + 3);
+			clipToChildren(polygon, centre, 0, 0, children);
+			clippedTriangles++;
+		}
+		triangles = {};
+
+		for (uint32_t child = 0; child < 8; child++) {
+			if (children[child].size() == 0) continue;
+			const float3 childMin = nodeMin + float3(child & 1 ? childSize : 0.f, child & 2 ? childSize : 0.f, child & 4 ? childSize : 0.f);
+			splitNode(world, childMin, childSize, depth + 1, std::move(children[child]), leaves, clippedTriangles);
+		}
+	}
+
+	static double boundsVolume(float3 boundsMin, float3 boundsMax)
+	{
+		const float3 extent = glm::max(boundsMax - boundsMin, float3(0.f));
+		return static_cast<double>(extent.x) * extent.y * extent.z;
+	}
+
+	template<typename F>
+	static void parallelFor(size_t count, F f)
+	{
+		std::atomic<size_t> next = 0;
+		std::vector<std::thread> workers;
+		for (uint32_t i = 0; i < std::max(1u, std::thread::hardware_concurrency()); i++) {
+			workers.emplace_back([&]() {
+				for (size_t j = next++; j < count; j = next++) f(j);
+			});
+		}
+		for (auto& worker : workers) worker.join();
+	}
+
+	std::vector<WorldCluster> buildWorldClusters(const MeshData& world, HashCache<WorldCluster>& clusterCache, WorldClusterStats& stats)
+	{
+		PROFILE("buildWorldClusters");
+		const auto start = std::chrono::steady_clock::now();
+
+		NodeTriangles triangles;
+		triangles.whole.resize(world.getVertexCount() / 3);
+		for (uint32_t i = 0; i < triangles.whole.size(); i++) triangles.whole[i] = i;
+
+		std::vector<OctreeLeaf> leaves;
+		uint32_t clippedTriangles = 0;
+		splitNode(world, float3(-kRootHalfSize), kRootHalfSize * 2.f, 0, std::move(triangles), leaves, clippedTriangles);
+
+		// Hash and bound every leaf in parallel, then only build the meshes that weren't in the cache
+		std::vector<WorldCluster> clusters(leaves.size());
+		parallelFor(leaves.size(), [&](size_t i) {
+			WorldCluster& cluster = clusters[i];
+			cluster.triangleCount = static_cast<uint32_t>(leaves[i].triangles.size());
+			cluster.boundsMin = float3(std::numeric_limits<float>::max());
+			cluster.boundsMax = float3(-std::numeric_limits<float>::max());
+
+			uint64_t hash = hashValue(world.getFlipWinding(), hashValue(world.isQuantised()));
+			auto addVertex = [&](const float3& position, const float3& normal, const float2& texCoord) {
+				hash = hashValue(texCoord, hashValue(normal, hashValue(position, hash)));
+				cluster.boundsMin = glm::min(cluster.boundsMin, position);
+				cluster.boundsMax = glm::max(cluster.boundsMax, position);
+			};
+			for (uint32_t triangle : leaves[i].triangles.whole) {
+				for (uint32_t v = triangle * 3; v < triangle * 3 + 3; v++) addVertex(world.getPosition(v), world.getNormal(v), world.getTexCoord(v));
+			}
+			for (const ClusterVertex& vertex : leaves[i].triangles.pieces) addVertex(vertex.position, vertex.normal, vertex.texCoord);
+			cluster.hash = hash;
+		});
+
+		std::vector<size_t> toBuild;
+		for (size_t i = 0; i < clusters.size(); i++) {
+			if (!clusterCache.find(clusters[i].hash, clusters[i])) toBuild.push_back(i);
+		}
+
+		parallelFor(toBuild.size(), [&](size_t j) {
+			const size_t i = toBuild[j];
+			TriangleMesh::SharedPtr pMesh = TriangleMesh::create();
+			pMesh->setName(leaves[i].name);
+			auto addTriangle = [&]() {
+				const uint32_t first = static_cast<uint32_t>(pMesh->getVertices().size()) - 3;
+				if (world.getFlipWinding()) pMesh->addTriangle(first + 2, first + 1, first);
+				else pMesh->addTriangle(first, first + 1, first + 2);
+			};
+			for (uint32_t triangle : leaves[i].triangles.whole) {
+				for (uint32_t v = triangle * 3; v < triangle * 3 + 3; v++) pMesh->addVertex(world.getPosition(v), world.getNormal(v), world.getTexCoord(v));
+				addTriangle();
+			}
+			const std::vector<ClusterVertex>& pieces = leaves[i].triangles.pieces;
+			for (size_t v = 0; v < pieces.size(); v += 3) {
+				for (size_t k = v; k < v + 3; k++) pMesh->addVertex(pieces[k].position, pieces[k].normal, pieces[k].texCoord);
+				addTriangle();
+			}
+			clusters[i].pMesh = pMesh;
+		});
+
+		for (size_t i : toBuild) clusterCache.insert(clusters[i].hash, clusters[i]);
+
+		// Stats, the overlap is what the separate BLASes cost in extra traversal (rays inside overlapping bounds test both)
+		stats = {};
+		stats.clusterCount = static_cast<uint32_t>(clusters.size());
+		stats.rebuilt = static_cast<uint32_t>(toBuild.size());
+		stats.clippedTriangles = clippedTriangles;
+		stats.minTriangles = clusters.empty() ? 0 : std::numeric_limits<uint32_t>::max();
+		double totalVolume = 0.0;
+		double overlapVolume = 0.0;
+		for (size_t i = 0; i < clusters.size(); i++) {
+			const WorldCluster& a = clusters[i];
+			stats.minTriangles = std::min(stats.minTriangles, a.triangleCount);
+			stats.maxTriangles = std::max(stats.maxTriangles, a.triangleCount);
+			stats.totalTriangles += a.triangleCount;
+			totalVolume += boundsVolume(a.boundsMin, a.boundsMax);
+			for (size_t j = i + 1; j < clusters.size(); j++) {
+				const WorldCluster& b = clusters[j];
+				overlapVolume += boundsVolume(glm::max(a.boundsMin, b.boundsMin), glm::min(a.boundsMax, b.boundsMax));
+			}
+		}
+		stats.overlapPercent = totalVolume > 0.0 ? static_cast<float>(100.0 * overlapVolume / totalVolume) : 0.f;
+		stats.buildMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		return clusters;
+	}
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "Falcor.h"
+#include "MeshData.h"
+#include "SceneCache.h"
+
+namespace GModDXR
+{
+	// A spatial piece of the world, added to the scene as its own mesh instance
+	struct WorldCluster
+	{
+		uint64_t hash; // Content hash of the cluster's vertices (positions, normals and texture coordinates)
+		Falcor::TriangleMesh::SharedPtr pMesh;
+		Falcor::float3 boundsMin;
+		Falcor::float3 boundsMax;
+		uint32_t triangleCount;
+	};
+
+	struct WorldClusterStats
+	{
+		uint32_t clusterCount = 0;
+		uint32_t minTriangles = 0;
+		uint32_t maxTriangles = 0;
+		uint32_t totalTriangles = 0;
+		uint32_t rebuilt = 0;          // Clusters whose mesh had to be built this launch
+		uint32_t clippedTriangles = 0; // Triangles cut at a split plane (pieces of big ones can be cut again further down)
+		float overlapPercent = 0.f;    // Summed pairwise intersection volume of the cluster bounds, relative to their total volume
+		float buildMs = 0.f;
+	};
+
+	/*
+		Splits the world into clusters with a fixed octree (rooted at the map's coordinate limits, not the world's bounds)
+		Nodes with more than kMaxClusterTriangles triangles are split, triangles crossing a split plane are clipped into a piece per child
+		so every cluster stays inside its cell and the cluster bounds (and so their BLASes) don't overlap
+
+		Because the cell boundaries never move, editing part of the map only changes the clusters the edit touches,
+		and the rest are found in clusterCache by content hash instead of being rebuilt
+		Hashing and mesh building are spread over all cores
+	*/
+	std::vector<WorldCluster> buildWorldClusters(const MeshData& world, HashCache<WorldCluster>& clusterCache, WorldClusterStats& stats);
+}
@@ -41,5 +41,12 @@ LaunchFalcor(
 	PLR:EyePos(),
 	PLR:EyePos() + PLR:EyeAngles():Forward(),
 	-util.GetSunInfo().direction,
-	table.Add(ents.FindByClass("prop_physics"), ents.FindByClass("prop_ragdoll"))
+	table.Add(ents.FindByClass("prop_physics"), ents.FindByClass("prop_ragdoll")),
+	{
+		triangleBudget = 4000000,   -- Total entity triangles to capture, 0 for no limit
+		minScreenSize = 0.002,      -- Skip entities whose bounding radius to distance ratio is below this
+		lodScreenSize = 0.02,       -- Use lower LODs for entities smaller than this
+		compactCpuVertices = false, -- Keep captured geometry quantised to save CPU memory (GPU buffers are unchanged)
+		outOfProcess = false        -- Render in a separate process (GModDXRHost.exe) so a renderer crash can't take the game down
+	}
 )